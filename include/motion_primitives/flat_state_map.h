@@ -0,0 +1,114 @@
+// Copyright 2021 Laura Jarin-Lipschitz
+#ifndef MOTION_PRIMITIVES_FLAT_STATE_MAP_H_
+#define MOTION_PRIMITIVES_FLAT_STATE_MAP_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace motion_primitives {
+
+// Flat open-addressing hash map keyed by a search state, replacing the
+// node-based std::unordered_map in the GraphSearch bookkeeping, which
+// allocates per insert and chases pointers per lookup. Slots are stored
+// contiguously with power-of-two capacity and quadratic probing; memory is
+// only touched on rehash, and clear() keeps the capacity so a table can be
+// reused across searches. Erase is not supported (the search never needs it).
+template <typename State, typename Value, typename Hash>
+class FlatStateMap {
+ public:
+  explicit FlatStateMap(std::size_t expected_size = 16) {
+    std::size_t capacity = 16;
+    while (capacity < expected_size * 2) capacity *= 2;
+    slots_.resize(capacity);
+  }
+
+  // Inserts a default-constructed Value if the key is absent.
+  Value& operator[](const State& key) {
+    if ((size_ + 1) * 10 >= slots_.size() * 7) grow();
+    Slot& slot = find_slot(slots_, key);
+    if (!slot.occupied) {
+      slot.occupied = true;
+      slot.key = key;
+      ++size_;
+    }
+    return slot.value;
+  }
+
+  const Value* find(const State& key) const {
+    const Slot& slot =
+        find_slot(const_cast<std::vector<Slot>&>(slots_), key);
+    return slot.occupied ? &slot.value : nullptr;
+  }
+
+  // Precondition: the key is present (unlike std::unordered_map::at, which
+  // throws).
+  const Value& at(const State& key) const { return *find(key); }
+
+  std::size_t size() const noexcept { return size_; }
+
+  void clear() {
+    for (auto& slot : slots_) slot.occupied = false;
+    size_ = 0;
+  }
+
+  template <typename F>
+  void for_each(F&& f) const {
+    for (const auto& slot : slots_) {
+      if (slot.occupied) f(slot.key, slot.value);
+    }
+  }
+
+ private:
+  struct Slot {
+    State key;
+    Value value{};
+    bool occupied{false};
+  };
+
+  Slot& find_slot(std::vector<Slot>& slots, const State& key) const {
+    const std::size_t mask = slots.size() - 1;
+    std::size_t idx = Hash{}(key)&mask;
+    for (std::size_t probe = 1;; ++probe) {
+      Slot& slot = slots[idx];
+      if (!slot.occupied || slot.key == key) return slot;
+      idx = (idx + probe) & mask;  // quadratic probing
+    }
+  }
+
+  void grow() {
+    std::vector<Slot> bigger(slots_.size() * 2);
+    for (auto& slot : slots_) {
+      if (!slot.occupied) continue;
+      find_slot(bigger, slot.key) = std::move(slot);
+    }
+    slots_ = std::move(bigger);
+  }
+
+  std::vector<Slot> slots_;
+  std::size_t size_{0};
+};
+
+// Companion set with the interface the search needs.
+template <typename State, typename Hash>
+class FlatStateSet {
+ public:
+  explicit FlatStateSet(std::size_t expected_size = 16)
+      : map_(expected_size) {}
+
+  bool contains(const State& key) const { return map_.find(key) != nullptr; }
+  void insert(const State& key) { map_[key] = true; }
+  std::size_t size() const noexcept { return map_.size(); }
+  void clear() { map_.clear(); }
+
+  template <typename F>
+  void for_each(F&& f) const {
+    map_.for_each([&f](const State& key, bool) { f(key); });
+  }
+
+ private:
+  FlatStateMap<State, bool, Hash> map_;
+};
+
+}  // namespace motion_primitives
+#endif  // MOTION_PRIMITIVES_FLAT_STATE_MAP_H_
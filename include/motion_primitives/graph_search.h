@@ -3,35 +3,49 @@
 #define MOTION_PRIMITIVES_GRAPH_SEARCH_H_
 
 #include <kr_planning_msgs/VoxelMap.h>
+#include <tbb/concurrent_unordered_map.h>
+#include <tbb/enumerable_thread_specific.h>
 
+#include <atomic>
 #include <boost/timer/timer.hpp>
+#include <cstdint>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
-#include <queue>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "motion_primitives/flat_state_map.h"
 #include "motion_primitives/motion_primitive_graph.h"
+#include "motion_primitives/open_list.h"
+#include "motion_primitives/profiler.h"
 
 namespace motion_primitives {
 
+// spatial_dim is at most 3 and control_space_dim at most 3, so a state never
+// exceeds 9 coefficients and can be stored inline (see GraphSearch::State).
+inline constexpr int kMaxStateDim = 9;
+
 // First convert VectorXd to VectorXi by some scaling then hash
 // This is to avoid potential floating point error causing the same state to
 // hash to different values
 // NOTE: Ideally this should be part of the implementation, we put in the public
 // namespace so that we can test it
+// Takes a Ref so both VectorXd and the inline State bind without copying.
 struct VectorXdHash : std::unary_function<Eigen::VectorXd, std::size_t> {
-  std::size_t operator()(const Eigen::VectorXd& vd) const noexcept;
+  std::size_t operator()(const Eigen::Ref<const Eigen::VectorXd>& vd) const
+      noexcept;
 };
 
 double Elapsed(const boost::timer::cpu_timer& timer) noexcept;
 // Check if two positions are within the L2 distance d of each other.
-bool StatePosWithin(const Eigen::VectorXd& p1, const Eigen::VectorXd& p2,
+bool StatePosWithin(const Eigen::Ref<const Eigen::VectorXd>& p1,
+                    const Eigen::Ref<const Eigen::VectorXd>& p2,
                     int spatial_dim, double d) noexcept;
 
 // Holds the graph and map information, and provides a search interface for
@@ -41,11 +55,15 @@ class GraphSearch {
   MotionPrimitiveGraph graph_;
   Eigen::Vector3i map_dims_;
   Eigen::Vector3d map_origin_;
-  kr_planning_msgs::VoxelMap voxel_map_;
+  double map_resolution_{0};
 
  public:
  //TODO(Laura) define State (pos,vel, etc.)
-  using State = Eigen::VectorXd;
+  // Dynamic size with a compile-time max so the coefficients live inline:
+  // Node copies, hash table keys and priority queue entries stay off the
+  // heap, unlike a plain Eigen::VectorXd.
+  using State = Eigen::Matrix<double, Eigen::Dynamic, 1, Eigen::ColMajor,
+                              kMaxStateDim, 1>;
   struct Option {
     State start_state;
     State goal_state;
@@ -58,6 +76,47 @@ class GraphSearch {
     double velocity_threshold = -1;
     bool using_ros{true};
     double step_size{0.1};
+    // Whether unknown voxels (-1 in VoxelMap.data) are treated as free.
+    // Matches the historical behavior when true.
+    bool unknown_is_free{true};
+    // Build a distance field from the voxel map and let the collision check
+    // advance along a primitive by the clearance at each sample, instead of
+    // probing at every fixed step. Big win in mostly-empty flight volumes.
+    bool use_esdf{false};
+    // Whole-search parallelism (HDA*-style): states are partitioned across
+    // workers by VectorXdHash, each worker owns its open list and history
+    // and routes generated nodes to the owning worker through concurrent
+    // queues. Scales far better than parallel_expand (which only forks the
+    // successor loop of one node) but may return a slightly suboptimal path
+    // since workers race to the goal.
+    bool hda_star{false};
+    int num_threads{0};  // for hda_star; 0 means hardware concurrency
+    // Wall-clock budget for Search() in seconds; <= 0 means unlimited. When
+    // it expires, Search returns the best path found so far, or a partial
+    // path toward the expanded node with the lowest heuristic cost so the
+    // tracker has something to fly while the next replan refines it.
+    double deadline{-1};
+    // Weighted A* inflation applied to the heuristic. > 1 finds a first
+    // (bounded-suboptimal) path sooner; Search then re-runs on a decreasing
+    // schedule toward 1 while the deadline budget lasts, keeping the best.
+    double heuristic_inflation{1.0};
+    // Cooperative cancellation: Search polls this each expansion and exits
+    // empty-handed once it reads true, so another thread (e.g. the action
+    // server accepting a preempting goal) can abort an in-flight search.
+    std::shared_ptr<std::atomic_bool> cancel_token;
+    // Corridor focus from a cascade pre-search (see PlanningServer): each
+    // column is a position sampled along a coarse-graph path (spatial_dim
+    // rows). Successor states farther than corridor_radius from every
+    // column are pruned before the collision check. Empty disables.
+    Eigen::MatrixXd corridor;
+    double corridor_radius{0};
+    // Optional goal-directed prune: discard a successor whose end position
+    // retreats from the goal by more than this many meters (infinity norm,
+    // the metric under the min_time heuristic) relative to its parent.
+    // Negative disables. Sacrifices completeness around large obstacles
+    // that must be flown around, so meant for tightly budgeted replans
+    // where backward-facing primitives mostly bloat the open list.
+    double prune_goal_retreat{-1};
   };
   struct Node {
     static constexpr auto kInfCost = std::numeric_limits<double>::infinity();
@@ -70,9 +129,99 @@ class GraphSearch {
     double total_cost() const noexcept { return motion_cost + heuristic_cost; }
   };
 
+  struct SearchScratch;  // defined below PathHistory/StateSet
+
+  // State that is worth carrying between consecutive planning queries.
+  // PlanningServer replans at a few Hz toward a goal that barely moves, so a
+  // fresh GraphSearch per query throws away work the next query redoes. A
+  // caller-owned SearchContext survives across GraphSearch instances; the
+  // constructor adopts it and resets whatever its new query invalidates:
+  // the heuristic cache is dropped when the goal or graph changes (map
+  // changes do not touch it since the heuristics ignore obstacles), the
+  // collision cache when the graph changes or the map owner reports that
+  // voxels intersecting a cached verdict changed.
+  struct SearchContext {
+    tbb::concurrent_unordered_map<State, double, VectorXdHash> heuristic_cache;
+    // Query the cache was filled for; mismatch with the next query's options
+    // empties it.
+    State goal_state;
+    const MotionPrimitiveGraph* graph{nullptr};
+
+    // Collision verdicts carried across queries. Since translate() only
+    // shifts positions, a primitive's samples are its stored table plus the
+    // start position, so the verdict is a function of (edge, start
+    // position). The key quantizes the start to the world-frame voxel
+    // lattice (independent of a sliding map origin); the stored AABB covers
+    // the probed samples so map diffs can invalidate precisely.
+    struct CollisionKey {
+      int mp_index;
+      Eigen::Vector3i cell;
+      bool operator==(const CollisionKey& other) const noexcept {
+        return mp_index == other.mp_index && cell == other.cell;
+      }
+    };
+    struct CollisionKeyHash {
+      std::size_t operator()(const CollisionKey& key) const noexcept {
+        std::size_t seed = std::hash<int>()(key.mp_index);
+        for (int i = 0; i < 3; ++i) {
+          seed ^= std::hash<int>()(key.cell[i]) + 0x9e3779b9 + (seed << 6) +
+                  (seed >> 2);
+        }
+        return seed;
+      }
+    };
+    struct CollisionVerdict {
+      Eigen::Vector3f aabb_min;
+      Eigen::Vector3f aabb_max;
+      bool free;
+    };
+    tbb::concurrent_unordered_map<CollisionKey, CollisionVerdict,
+                                  CollisionKeyHash>
+        collision_cache;
+
+    // World-space boxes whose voxels changed since the verdicts were
+    // cached. The map owner appends them from any thread; erasure is not
+    // safe against concurrent lookups, so the next GraphSearch constructor
+    // (no search running) drains them via ApplyPendingInvalidations.
+    using DirtyBox = std::pair<Eigen::Vector3f, Eigen::Vector3f>;
+    void MarkDirty(const std::vector<DirtyBox>& boxes);
+    // Requests dropping every verdict (map geometry changed, e.g. a sliding
+    // origin re-bins all voxels).
+    void DropCollisionCache();
+    void ApplyPendingInvalidations();
+
+    // Pooled per-search storage (tables, open list, expansion scratch),
+    // allocated lazily by the adopting GraphSearch and reset with cheap
+    // clears that keep the high-water capacity; see SearchScratch.
+    std::unique_ptr<SearchScratch> scratch;
+
+    SearchContext() = default;
+    ~SearchContext();  // out of line: SearchScratch is incomplete here
+
+   private:
+    std::mutex dirty_mutex_;
+    std::vector<DirtyBox> pending_dirty_;
+    bool drop_collision_cache_{false};
+  };
+
+  // Zero-copy handle on a shared voxel map, plus a small overlay of voxels
+  // to treat as free regardless of what the map says (e.g. the robot
+  // footprint). Lets the planner read the subscriber's map in place instead
+  // of duplicating the multi-megabyte data vector per query just to flip a
+  // few hundred voxels.
+  struct VoxelMapView {
+    kr_planning_msgs::VoxelMapConstPtr map;
+    // Linear indices into map->data forced free.
+    std::vector<int> cleared;
+  };
+
   GraphSearch(const MotionPrimitiveGraph& graph,
               const kr_planning_msgs::VoxelMap& voxel_map,
-              const Option& options);
+              const Option& options,
+              std::shared_ptr<SearchContext> context = nullptr);
+  GraphSearch(const MotionPrimitiveGraph& graph, const VoxelMapView& map_view,
+              const Option& options,
+              std::shared_ptr<SearchContext> context = nullptr);
 
   ~GraphSearch() = default;
   const Option options_;
@@ -83,7 +232,9 @@ class GraphSearch {
   std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> Search();
 
   std::vector<Eigen::VectorXd> GetVisitedStates() const noexcept;
-  const auto& timings() const noexcept { return timings_; }
+  // Per-search counters and phase timers, cleared by Search(); see
+  // profiler.h for what is collected and the compile-time kill switch.
+  const SearchProfiler& profiler() const noexcept { return profiler_; }
   int spatial_dim() const noexcept { return graph_.spatial_dim_; }
   // Shift a polynomial (defined by its coefficients) by a given time.
   static Eigen::MatrixXd shift_polynomial(const Eigen::MatrixXd poly_coeffs,
@@ -93,27 +244,60 @@ class GraphSearch {
   // Node is a wrapper around state that also carries the cost info
 
  private:
+  // Lets tests/benchmark_graph_search.cpp time the private hot paths
+  // (expansion, collision checks, heuristics) directly instead of only
+  // through Search().
+  friend struct GraphSearchBenchmarkAccess;
+
   // The state is the key of PathHistory and will not be stored here
   struct StateInfo {
     Node parent_node;                  // parent node of this state
     double best_cost{Node::kInfCost};  // best cost reaching this state so far
   };
 
-  // Path history stores the parent node of this state and the best cost so far
-  using PathHistory = std::unordered_map<State, StateInfo, VectorXdHash>;
+  // Path history stores the parent node of this state and the best cost so
+  // far. Flat open-addressing tables since Search does a lookup per generated
+  // successor.
+  using PathHistory = FlatStateMap<State, StateInfo, VectorXdHash>;
   std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> RecoverPath(
       const PathHistory& history, const Node& end_node) const;
 
   typedef double (motion_primitives::GraphSearch::*FUNCPTR)(
       const State& v, const State& goal_state) const;
   std::unordered_map<std::string, FUNCPTR> heuristic_types_map_;
+  // Resolved once from options_.heuristic at construction so the expansion
+  // hot loop never repeats the string-keyed map lookup.
+  FUNCPTR heuristic_fn_{nullptr};
+  // True for the analytic heuristics whose math vectorizes over a matrix of
+  // states (see ComputeHeuristicBatch).
+  bool batch_heuristic_{false};
 
   double ComputeHeuristic(const State& state, const State& goal_state) const;
+  // Heuristics for one state per column of states, in one Eigen pass for
+  // the batchable heuristics and a scalar loop otherwise.
+  Eigen::VectorXd ComputeHeuristicBatch(const Eigen::MatrixXd& states,
+                                        const State& goal_state) const;
+  // Fills heuristic_cost (inflated) for every node; batches when possible.
+  void ApplyHeuristics(std::vector<Node>* nodes, const State& goal_state) const;
+
+  // Memoized heuristic values live in the context. VectorXdHash already
+  // quantizes states to 0.01, so states re-reached through different parents
+  // hit the cache. Only consulted for the BVP heuristics, where the per-call
+  // optimizer dominates; since the context outlives this GraphSearch when
+  // supplied by the caller, consecutive replans toward the same goal reuse
+  // it. Concurrent because ExpandPar computes heuristics from worker threads.
+  std::shared_ptr<SearchContext> context_;
+  bool cache_heuristic_{false};
   double ComputeHeuristicZero(const State& v, const State& goal_state) const;
   double ComputeHeuristicRuckigBVP(const State& v,
                                    const State& goal_state) const;
   double ComputeHeuristicMinTime(const State& v, const State& goal_state) const;
   double ComputeHeuristicETHBVP(const State& v, const State& goal_state) const;
+  // Closed-form per-axis lower bound on the min-time BVP duration; an
+  // admissible stand-in for ruckig_bvp without constructing a primitive or
+  // running the trajectory synthesis.
+  double ComputeHeuristicMinTimeBVP(const State& v,
+                                    const State& goal_state) const;
 
   std::vector<Node> Expand(const Node& node, const State& goal_state) const;
   std::vector<Node> ExpandPar(const Node& node, const State& goal_state) const;
@@ -121,16 +305,94 @@ class GraphSearch {
                                          const Node& node,
                                          const State& goal_state) const;
 
-  std::pair<std::vector<Node>, PathHistory> AccessGraph(
-      const State& start_state) const;
+  // Seeds history (borrowed from the scratch pool) and returns the start
+  // nodes the main loop begins from.
+  std::vector<Node> AccessGraph(const State& start_state,
+                                PathHistory* history) const;
 
   std::shared_ptr<MotionPrimitive> GetPrimitiveBetween(
       const Node& start_node, const Node& end_node) const;
 
-  using StateSet = std::unordered_set<State, VectorXdHash>;
-  StateSet visited_states_;
-  // internal use only, stores (wall) time spent on different parts
-  std::unordered_map<std::string, double> timings_;
+  using StateSet = FlatStateSet<State, VectorXdHash>;
+
+  // Everything ExpandSingleNode does, but checked against the provided
+  // visited set (may be null) instead of the shared one, so the HDA* workers
+  // can use their partition-local sets without races. With defer_heuristic
+  // the returned node's heuristic_cost is left at 0 for the caller to fill
+  // in batch (see ApplyHeuristics).
+  std::pair<bool, Node> GenerateSuccessor(int index1, int index2,
+                                          const Node& node,
+                                          const State& goal_state,
+                                          const StateSet* visited,
+                                          bool defer_heuristic = false) const;
+  // Hash-distributed parallel search, dispatched from Search() when
+  // options_.hda_star is set.
+  std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> SearchHDA();
+  // One weighted A* pass with the current heuristic_inflation_; timer is the
+  // shared clock the deadline is measured against. *partial is set when the
+  // returned path was truncated at the deadline — its last leg is a
+  // synthesized best effort toward the goal, not a goal-reaching search
+  // result, so its cost is not comparable to a complete path's.
+  std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> SearchOnce(
+      const boost::timer::cpu_timer& search_timer, bool* partial);
+  // Inflation of the current pass, applied where heuristic costs are
+  // assigned (only priorities are inflated, never motion costs).
+  double heuristic_inflation_{1.0};
+  bool cancelled() const noexcept {
+    return options_.cancel_token &&
+           options_.cancel_token->load(std::memory_order_relaxed);
+  }
+  // True when position lies within corridor_radius of some corridor sample
+  // (trivially true with no corridor). One vectorized distance pass over the
+  // corridor columns; cheap next to a collision check.
+  bool in_corridor(const Eigen::Ref<const Eigen::VectorXd>& position) const {
+    if (options_.corridor.cols() == 0) return true;
+    return (options_.corridor.colwise() - position)
+               .colwise()
+               .squaredNorm()
+               .minCoeff() <=
+           options_.corridor_radius * options_.corridor_radius;
+  }
+  // Mutable so the const expansion/collision/heuristic paths can count.
+  mutable SearchProfiler profiler_;
+
+  // Packed 1-bit occupancy, built once in the constructor from
+  // VoxelMap.data (one int8 per voxel would blow L2 on large local maps).
+  // A set bit means occupied, where unknown voxels count as occupied or free
+  // depending on options_.unknown_is_free. Probes are a single shift/mask.
+  std::vector<uint64_t> occupancy_bitmap_;
+  int map_stride_y_{0};
+  int map_stride_z_{0};
+  // Chebyshev distance (in voxels, capped at 255) to the nearest occupied
+  // voxel or map boundary, built by build_esdf when options_.use_esdf is
+  // set. Chebyshev lower-bounds the Euclidean clearance, so it is safe for
+  // sample skipping; folding the boundary in keeps the skip from jumping
+  // over out-of-map samples, which count as collisions.
+  // Also usable as a clearance-weighted cost hook.
+  std::vector<uint8_t> esdf_;
+
+  // Adopts (or creates) the caller's SearchContext, dropping its caches if
+  // the goal or graph changed since the query that filled them, and borrows
+  // its scratch pool.
+  void AdoptContext(const MotionPrimitiveGraph* graph_identity);
+  // Borrowed from context_->scratch for this instance's lifetime; never
+  // null after construction.
+  SearchScratch* scratch_{nullptr};
+  // Shared constructor tail: extracts map metadata and packs occupancy
+  // (with the overlay voxels forced free). The map itself is not retained;
+  // everything the search probes lives in the bitmap / ESDF.
+  void InitMap(const kr_planning_msgs::VoxelMap& voxel_map,
+               const std::vector<int>& cleared);
+  void build_esdf();
+  // Clearance in voxels at given (valid) indices; 0 means occupied.
+  int esdf_clearance(const Eigen::Vector3i& indices) const {
+    return esdf_[get_linear_indices(indices)];
+  }
+  // Probes every column of samples (+ offset) against the map, advancing by
+  // the ESDF clearance when available.
+  bool are_positions_collision_free(
+      const Eigen::MatrixXd& samples,
+      const Eigen::Ref<const Eigen::VectorXd>& offset, double step_size) const;
 
   Eigen::Vector3i get_indices_from_position(
       const Eigen::Vector3d& position) const;
@@ -144,6 +406,29 @@ class GraphSearch {
   // collisions
   bool is_mp_collision_free(const std::shared_ptr<MotionPrimitive> mp,
                             double step_size = 0.2) const;
+  // Same check for a graph primitive that is conceptually translated so its
+  // start position sits at new_start, without cloning or translating it.
+  // translate() only shifts positions (it rewrites the constant polynomial
+  // coefficient), so the translated samples are the stored samples plus a
+  // fixed offset. This keeps the expansion hot loop free of heap allocation.
+  bool is_mp_collision_free_translated(
+      const MotionPrimitive& mp,
+      const Eigen::Ref<const Eigen::VectorXd>& new_start,
+      double step_size = 0.2) const;
+
+ public:
+  // Pooled per-search storage, owned by SearchContext and borrowed by each
+  // GraphSearch. The tables and open list clear in O(occupied) while keeping
+  // their high-water capacity, and the thread-local expansion buffers keep
+  // theirs across expansions, so a replan at a few Hz reuses warm memory
+  // instead of growing every structure from empty (the malloc spikes that
+  // used to front-load each query).
+  struct SearchScratch {
+    PathHistory history{1024};
+    StateSet visited{1024};
+    OpenList<Node> queue{1024};
+    tbb::enumerable_thread_specific<std::vector<Node>> expand_tls;
+  };
 };  // class GraphSearch
 }  // namespace motion_primitives
 #endif  // MOTION_PRIMITIVES_GRAPH_SEARCH_H_
\ No newline at end of file
@@ -50,6 +50,14 @@ class MotionPrimitive {
   static Eigen::VectorXd evaluate_primitive(float t, Eigen::VectorXd coeffs);
   virtual Eigen::VectorXd evaluate_primitive(float t) const;
 
+  // Batched position evaluation at all given times at once. The polynomial
+  // base builds the matrix of time powers incrementally (no pow() calls) and
+  // gets every sample from a single coefficients-times-powers product, which
+  // Eigen vectorizes; one column of the result per time. Subclasses whose
+  // evaluation is not a stored polynomial fall back to a per-time loop.
+  virtual Eigen::MatrixXd evaluate_positions(const Eigen::VectorXd& times)
+      const;
+
   // Moves the motion primitive to a new position by modifying it's start, end,
   // and polynomial coefficients
   virtual void translate(const Eigen::VectorXd& new_start);
@@ -88,7 +96,7 @@ class MotionPrimitive {
   // Translating the objects inside the graph adjacency matrix caused problems,
   // so we instead make a copy for outputting in the graph search and doing
   // collision checks.
-  virtual std::shared_ptr<MotionPrimitive> clone() {
+  virtual std::shared_ptr<MotionPrimitive> clone() const {
     return std::make_shared<MotionPrimitive>(*this);
   }
 };
@@ -108,13 +116,22 @@ class RuckigMotionPrimitive final : public MotionPrimitive {
                         const Eigen::VectorXd& max_state, bool compute = false);
 
   ruckig::Trajectory<3> ruckig_traj_;
+  // The jerk/time profile is translation-invariant: moving start and end by
+  // the same offset leaves it unchanged and only shifts positions. The
+  // profile is therefore kept relative to the start it was computed at
+  // (profile_start_) and evaluation adds position_offset_, making
+  // translate() O(1) instead of a full ruckig re-optimization.
+  bool profile_valid_{false};
+  Eigen::Vector3d profile_start_ = Eigen::Vector3d::Zero();
+  Eigen::Vector3d position_offset_ = Eigen::Vector3d::Zero();
 
   Eigen::VectorXd evaluate_primitive(float t) const;
+  Eigen::MatrixXd evaluate_positions(const Eigen::VectorXd& times) const;
   void translate(const Eigen::VectorXd& new_start);
   void compute();
   kr_planning_msgs::Spline add_to_spline(kr_planning_msgs::Spline spline,
                                          int dim);
-  std::shared_ptr<MotionPrimitive> clone() {
+  std::shared_ptr<MotionPrimitive> clone() const {
     return std::make_shared<RuckigMotionPrimitive>(*this);
   }
 };
@@ -132,6 +149,10 @@ class MotionPrimitiveGraph {
   friend class GraphSearch;
   friend void from_json(const nlohmann::json& json_data,
                         MotionPrimitiveGraph& graph);
+  friend void write_motion_primitive_graph_binary(
+      const MotionPrimitiveGraph& graph, const std::string& s);
+  friend MotionPrimitiveGraph read_motion_primitive_graph_binary(
+      const std::string& s);
   friend std::ostream& operator<<(std::ostream& out,
                                   const MotionPrimitiveGraph& graph);
 
@@ -141,6 +162,13 @@ class MotionPrimitiveGraph {
     return mps_[edges_(i, j)];
   }
 
+  // Reference access for the search hot loop, which must not copy or
+  // translate the stored primitive (see GraphSearch::ExpandSingleNode).
+  const MotionPrimitive& get_mp_ref_between_indices(int i, int j) const
+      noexcept {
+    return *mps_[edges_(i, j)];
+  }
+
   std::shared_ptr<MotionPrimitive> createMotionPrimitivePtrFromGraph(
       const Eigen::VectorXd& start_state,
       const Eigen::VectorXd& end_state) const {
@@ -149,6 +177,7 @@ class MotionPrimitiveGraph {
   }
 
   double rho() const noexcept { return rho_; }
+  double dispersion() const noexcept { return dispersion_; }
   int spatial_dim() const noexcept { return spatial_dim_; }
   int state_dim() const noexcept { return state_dim_; }
   int control_space_dim() const noexcept { return state_dim_ / spatial_dim_; }
@@ -160,6 +189,38 @@ class MotionPrimitiveGraph {
   bool HasEdge(int i, int j) const noexcept { return edges_(i, j) >= 0; }
   int NormIndex(int i) const noexcept { return std::floor(i / num_tiles_); }
 
+  // Compressed sparse (CSR-style) successor adjacency, built once at load.
+  // edges_ is mostly -1 on tiled graphs, so iterating its rows per expansion
+  // wastes cache lines on misses; the search iterates these lists instead.
+  // The successors of start vertex j are the contiguous range
+  // [successors_begin(j), successors_end(j)).
+  struct Successor {
+    int end_index;  // tiled end state index (row of edges_)
+    int mp_index;   // index into mps_
+  };
+  const Successor* successors_begin(int j) const noexcept {
+    return successors_.data() + successor_offsets_[j];
+  }
+  const Successor* successors_end(int j) const noexcept {
+    return successors_.data() + successor_offsets_[j + 1];
+  }
+  int num_successors(int j) const noexcept {
+    return successor_offsets_[j + 1] - successor_offsets_[j];
+  }
+
+  // Precomputes, for every primitive, its positions sampled step_size apart
+  // in the stored (untranslated) frame. Since translate() only shifts
+  // positions, a translated primitive's samples are these plus the new start
+  // position, so the search collision check avoids re-evaluating polynomials
+  // per expansion. Idempotent for a given step_size.
+  void precompute_sample_tables(double step_size);
+  bool has_sample_tables(double step_size) const noexcept {
+    return sample_table_step_size_ == step_size;
+  }
+  const Eigen::MatrixXd& sample_table(int i, int j) const noexcept {
+    return mp_sample_tables_[edges_(i, j)];
+  }
+
  private:
   std::vector<std::shared_ptr<MotionPrimitive>>
       mps_;                // TODO(laura) maybe should be unique_ptr
@@ -167,6 +228,14 @@ class MotionPrimitiveGraph {
                            // row, start index = column)
   Eigen::MatrixXd vertices_;
   Eigen::VectorXd max_state_;
+  // Parallel to mps_, filled by precompute_sample_tables.
+  std::vector<Eigen::MatrixXd> mp_sample_tables_;
+  double sample_table_step_size_{-1};
+  // CSR successor adjacency over edges_, see successors_begin.
+  std::vector<Successor> successors_;
+  std::vector<int> successor_offsets_;
+
+  void build_successor_lists();
 
   double dispersion_;
   double rho_ = 1;  // TODO(laura) decide about using rho in graph search
@@ -195,8 +264,17 @@ class MotionPrimitiveGraph {
 // MotionPrimitiveGraph object.
 void from_json(const nlohmann::json& json_data, MotionPrimitiveGraph& graph);
 // Creates the intermediate json objects to convert from a file location to a
-// MotionPrimitiveGraph.
+// MotionPrimitiveGraph. Dispatches on the file extension: ".mpb" files use the
+// binary format below, everything else goes through the JSON parser.
 MotionPrimitiveGraph read_motion_primitive_graph(const std::string& s);
+// Writes a graph to a compact binary file (flat arrays for the vertices,
+// edges and polynomial coefficients). Loading it back with
+// read_motion_primitive_graph_binary memory-maps the file and avoids the
+// per-edge json traversal, which takes seconds on large dispersion graphs.
+void write_motion_primitive_graph_binary(const MotionPrimitiveGraph& graph,
+                                         const std::string& s);
+// Reads a graph written by write_motion_primitive_graph_binary.
+MotionPrimitiveGraph read_motion_primitive_graph_binary(const std::string& s);
 
 template <typename T>
 std::ostream& operator<<(std::ostream& output, std::vector<T> const& values) {
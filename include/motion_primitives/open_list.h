@@ -0,0 +1,97 @@
+// Copyright 2021 Laura Jarin-Lipschitz
+#ifndef MOTION_PRIMITIVES_OPEN_LIST_H_
+#define MOTION_PRIMITIVES_OPEN_LIST_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace motion_primitives {
+
+// Purpose-built open list for the graph search, replacing
+// std::priority_queue<Node>. The heap itself only holds compact
+// (cost, index) pairs -- 16 bytes instead of a fat Node -- so sift
+// operations move little memory, and the 4-ary layout halves the tree depth
+// and keeps children of a node in one cache line. Node payloads live in a
+// side arena that grows monotonically, so top() references stay cheap.
+//
+// There is deliberately no decrease-key: pushing an improved node for the
+// same state leaves the old entry in the heap with its stale (higher) cost,
+// and the caller suppresses it at pop time against its visited set. This is
+// the lazy-deletion scheme the old std::priority_queue comment described,
+// made cheap because a stale pop only touches a 16-byte entry.
+template <typename Node>
+class OpenList {
+ public:
+  explicit OpenList(std::size_t expected_size = 1024) {
+    heap_.reserve(expected_size);
+    arena_.reserve(expected_size);
+  }
+
+  bool empty() const noexcept { return heap_.empty(); }
+  std::size_t size() const noexcept { return heap_.size(); }
+
+  void push(Node node) {
+    const Entry entry{node.total_cost(), arena_.size()};
+    arena_.push_back(std::move(node));
+    heap_.push_back(entry);
+    sift_up(heap_.size() - 1);
+  }
+
+  // Valid until the next push (the arena may reallocate).
+  const Node& top() const { return arena_[heap_.front().index]; }
+
+  void pop() {
+    heap_.front() = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) sift_down(0);
+  }
+
+  void clear() {
+    heap_.clear();
+    arena_.clear();
+  }
+
+ private:
+  struct Entry {
+    double cost;
+    std::size_t index;  // into arena_
+  };
+  static constexpr std::size_t kArity = 4;
+
+  void sift_up(std::size_t i) {
+    const Entry entry = heap_[i];
+    while (i > 0) {
+      const std::size_t parent = (i - 1) / kArity;
+      if (heap_[parent].cost <= entry.cost) break;
+      heap_[i] = heap_[parent];
+      i = parent;
+    }
+    heap_[i] = entry;
+  }
+
+  void sift_down(std::size_t i) {
+    const Entry entry = heap_[i];
+    const std::size_t n = heap_.size();
+    while (true) {
+      const std::size_t first_child = i * kArity + 1;
+      if (first_child >= n) break;
+      std::size_t best = first_child;
+      const std::size_t last_child = std::min(first_child + kArity, n);
+      for (std::size_t c = first_child + 1; c < last_child; ++c) {
+        if (heap_[c].cost < heap_[best].cost) best = c;
+      }
+      if (heap_[best].cost >= entry.cost) break;
+      heap_[i] = heap_[best];
+      i = best;
+    }
+    heap_[i] = entry;
+  }
+
+  std::vector<Entry> heap_;
+  std::vector<Node> arena_;
+};
+
+}  // namespace motion_primitives
+#endif  // MOTION_PRIMITIVES_OPEN_LIST_H_
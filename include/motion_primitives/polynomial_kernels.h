@@ -0,0 +1,76 @@
+// Copyright 2021 Laura Jarin-Lipschitz
+#ifndef MOTION_PRIMITIVES_POLYNOMIAL_KERNELS_H_
+#define MOTION_PRIMITIVES_POLYNOMIAL_KERNELS_H_
+
+#include <Eigen/Core>
+
+namespace motion_primitives {
+namespace poly_kernels {
+
+// Fixed-coefficient-count kernels for the polynomial hot paths. The
+// coefficient count is fixed per shipped graph (10 for the ETH degree-9
+// polynomials, 6 and fewer for the dispersion graphs) but poly_coeffs_ is a
+// dynamic MatrixXd, so Eigen sees every product as runtime-sized and neither
+// unrolls nor keeps temporaries off the heap. These templates pin the inner
+// dimension at compile time; call sites switch on cols() once and fall back
+// to the dynamic path for degrees we do not ship.
+
+// Pascal's triangle for the binomial theorem, covering up to degree 10.
+inline const Eigen::Matrix<int, 11, 11>& combinatorials() {
+  static const Eigen::Matrix<int, 11, 11> table =
+      (Eigen::Matrix<int, 11, 11>() << 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+       0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 3, 3, 1,
+       0, 0, 0, 0, 0, 0, 0, 1, 4, 6, 4, 1, 0, 0, 0, 0, 0, 0, 1, 5, 10, 10, 5,
+       1, 0, 0, 0, 0, 0, 1, 6, 15, 20, 15, 6, 1, 0, 0, 0, 0, 1, 7, 21, 35, 35,
+       21, 7, 1, 0, 0, 0, 1, 8, 28, 56, 70, 56, 28, 8, 1, 0, 0, 1, 9, 36, 84,
+       126, 126, 84, 36, 9, 1, 0, 1, 10, 45, 120, 210, 252, 210, 120, 45, 10,
+       1)
+          .finished();
+  return table;
+}
+
+// All positions at all sample times in one product; row k of the power
+// matrix holds t^(N - 1 - k), matching the highest-power-first layout of
+// poly_coeffs_ (see MotionPrimitive::evaluate_positions).
+template <int N>
+Eigen::MatrixXd evaluate_positions(const Eigen::MatrixXd& poly_coeffs,
+                                   const Eigen::VectorXd& times) {
+  Eigen::Matrix<double, N, Eigen::Dynamic> powers(N, times.size());
+  powers.row(N - 1).setOnes();
+  for (int k = N - 2; k >= 0; --k) {
+    powers.row(k) = powers.row(k + 1).cwiseProduct(times.transpose());
+  }
+  // Re-view the stored coefficients with the column count fixed so the
+  // product has a compile-time inner dimension.
+  Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, N>> coeffs(
+      poly_coeffs.data(), poly_coeffs.rows(), N);
+  return coeffs * powers;
+}
+
+// Binomial re-expansion of p(t + shift) with compile-time loop bounds and
+// incrementally built shift powers instead of a std::pow per term.
+template <int N>
+Eigen::MatrixXd shift_polynomial(const Eigen::MatrixXd& poly_coeffs,
+                                 double shift) {
+  const auto& comb = combinatorials();
+  Eigen::Matrix<double, N, 1> shift_pow;
+  shift_pow(0) = 1;
+  for (int i = 1; i < N; ++i) shift_pow(i) = shift_pow(i - 1) * shift;
+
+  const int n_rows = poly_coeffs.rows();
+  Eigen::MatrixXd ret_coeffs = Eigen::MatrixXd::Zero(n_rows, N);
+  for (int dim = 0; dim < n_rows; dim++) {
+    for (int order = N - 1; order >= 0; order--) {
+      for (int pos = 0; pos <= N - 1 - order; pos++) {
+        ret_coeffs(dim, N - 1 - order) +=
+            poly_coeffs(dim, pos) * comb(N - 1 - pos, N - 1 - pos - order) *
+            shift_pow(N - 1 - pos - order);
+      }
+    }
+  }
+  return ret_coeffs;
+}
+
+}  // namespace poly_kernels
+}  // namespace motion_primitives
+#endif  // MOTION_PRIMITIVES_POLYNOMIAL_KERNELS_H_
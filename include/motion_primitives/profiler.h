@@ -0,0 +1,173 @@
+// Copyright 2021 Laura Jarin-Lipschitz
+#ifndef MOTION_PRIMITIVES_PROFILER_H_
+#define MOTION_PRIMITIVES_PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compile-time switch for the search instrumentation. Defaults to on; build
+// with -DMOTION_PRIMITIVES_PROFILING=0 to compile every probe away.
+#ifndef MOTION_PRIMITIVES_PROFILING
+#define MOTION_PRIMITIVES_PROFILING 1
+#endif
+
+namespace motion_primitives {
+
+// Per-phase wall-time statistics: a compact histogram substitute (count,
+// total, min, max give mean and spread without per-sample storage).
+struct PhaseStats {
+  double total_s{0};
+  std::uint64_t count{0};
+  double min_s{std::numeric_limits<double>::infinity()};
+  double max_s{0};
+};
+
+// Instrumentation for one GraphSearch. Counters are relaxed atomics so the
+// parallel expansion paths can bump them without synchronization; phase
+// timers are only recorded from the search thread. With
+// MOTION_PRIMITIVES_PROFILING off every member function is an empty inline,
+// so call sites need no #ifdefs.
+class SearchProfiler {
+ public:
+  enum Phase {
+    kAccessGraph = 0,
+    kExpand,
+    kBookkeeping,
+    kNumPhases,
+  };
+
+  // RAII wall timer adding one sample to a phase.
+  class ScopedPhase {
+   public:
+    ScopedPhase(SearchProfiler& profiler, Phase phase)
+#if MOTION_PRIMITIVES_PROFILING
+        : profiler_(profiler),
+          phase_(phase),
+          start_(std::chrono::steady_clock::now())
+#endif
+    {
+    }
+    ~ScopedPhase() {
+#if MOTION_PRIMITIVES_PROFILING
+      const std::chrono::duration<double> dt =
+          std::chrono::steady_clock::now() - start_;
+      profiler_.add_phase_sample(phase_, dt.count());
+#endif
+    }
+
+   private:
+#if MOTION_PRIMITIVES_PROFILING
+    SearchProfiler& profiler_;
+    Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+#endif
+  };
+
+  void count_expansion() { bump(expansions_); }
+  void count_collision_check() { bump(collision_checks_); }
+  void count_collision_cache_hit() { bump(collision_cache_hits_); }
+  void count_heuristic_call() { bump(heuristic_calls_); }
+  void count_heuristic_calls(std::uint64_t n) {
+#if MOTION_PRIMITIVES_PROFILING
+    heuristic_calls_.fetch_add(n, std::memory_order_relaxed);
+#else
+    (void)n;
+#endif
+  }
+  void count_queue_push() { bump(queue_pushes_); }
+  void count_queue_pop() { bump(queue_pops_); }
+  void record_history_size(std::size_t size) {
+#if MOTION_PRIMITIVES_PROFILING
+    std::uint64_t prev = peak_history_size_.load(std::memory_order_relaxed);
+    while (prev < size && !peak_history_size_.compare_exchange_weak(
+                              prev, size, std::memory_order_relaxed)) {
+    }
+#else
+    (void)size;
+#endif
+  }
+
+  void add_phase_sample(Phase phase, double seconds) {
+#if MOTION_PRIMITIVES_PROFILING
+    auto& stats = phases_[phase];
+    stats.total_s += seconds;
+    stats.count++;
+    if (seconds < stats.min_s) stats.min_s = seconds;
+    if (seconds > stats.max_s) stats.max_s = seconds;
+#else
+    (void)phase;
+    (void)seconds;
+#endif
+  }
+
+  void clear() {
+#if MOTION_PRIMITIVES_PROFILING
+    expansions_ = 0;
+    collision_checks_ = 0;
+    collision_cache_hits_ = 0;
+    heuristic_calls_ = 0;
+    queue_pushes_ = 0;
+    queue_pops_ = 0;
+    peak_history_size_ = 0;
+    for (auto& stats : phases_) stats = PhaseStats{};
+#endif
+  }
+
+  // Flat key/value report, ready for logging or a diagnostics message.
+  std::vector<std::pair<std::string, double>> report() const {
+    std::vector<std::pair<std::string, double>> out;
+#if MOTION_PRIMITIVES_PROFILING
+    out.emplace_back("expansions", static_cast<double>(expansions_.load()));
+    out.emplace_back("collision_checks",
+                     static_cast<double>(collision_checks_.load()));
+    out.emplace_back("collision_cache_hits",
+                     static_cast<double>(collision_cache_hits_.load()));
+    out.emplace_back("heuristic_calls",
+                     static_cast<double>(heuristic_calls_.load()));
+    out.emplace_back("queue_pushes",
+                     static_cast<double>(queue_pushes_.load()));
+    out.emplace_back("queue_pops", static_cast<double>(queue_pops_.load()));
+    out.emplace_back("peak_history_size",
+                     static_cast<double>(peak_history_size_.load()));
+    static const char* kPhaseNames[kNumPhases] = {"access_graph", "expand",
+                                                  "bookkeeping"};
+    for (int p = 0; p < kNumPhases; p++) {
+      const auto& stats = phases_[p];
+      const std::string name = kPhaseNames[p];
+      out.emplace_back(name + "_total_s", stats.total_s);
+      out.emplace_back(name + "_count", static_cast<double>(stats.count));
+      if (stats.count > 0) {
+        out.emplace_back(name + "_min_s", stats.min_s);
+        out.emplace_back(name + "_max_s", stats.max_s);
+      }
+    }
+#endif
+    return out;
+  }
+
+ private:
+  void bump(std::atomic<std::uint64_t>& counter) {
+#if MOTION_PRIMITIVES_PROFILING
+    counter.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)counter;
+#endif
+  }
+
+  std::atomic<std::uint64_t> expansions_{0};
+  std::atomic<std::uint64_t> collision_checks_{0};
+  std::atomic<std::uint64_t> collision_cache_hits_{0};
+  std::atomic<std::uint64_t> heuristic_calls_{0};
+  std::atomic<std::uint64_t> queue_pushes_{0};
+  std::atomic<std::uint64_t> queue_pops_{0};
+  std::atomic<std::uint64_t> peak_history_size_{0};
+  PhaseStats phases_[kNumPhases];
+};
+
+}  // namespace motion_primitives
+#endif  // MOTION_PRIMITIVES_PROFILER_H_
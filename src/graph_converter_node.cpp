@@ -0,0 +1,29 @@
+// Copyright 2021 Laura Jarin-Lipschitz
+
+// One-time converter from the JSON motion primitive graph format to the
+// binary format ("<name>.mpb"), which loads near-instantly via mmap. Point
+// the PlanningServer graph_files param at the .mpb files to use them.
+#include <iostream>
+#include <string>
+
+#include "motion_primitives/motion_primitive_graph.h"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " graph1.json [graph2.json ...]\n";
+    return 1;
+  }
+  for (int i = 1; i < argc; i++) {
+    const std::string json_filename(argv[i]);
+    auto output_filename = json_filename;
+    const auto dot = output_filename.rfind('.');
+    if (dot != std::string::npos) output_filename.resize(dot);
+    output_filename += ".mpb";
+    const auto graph =
+        motion_primitives::read_motion_primitive_graph(json_filename);
+    motion_primitives::write_motion_primitive_graph_binary(graph,
+                                                           output_filename);
+    std::cout << "Wrote " << output_filename << "\n";
+  }
+  return 0;
+}
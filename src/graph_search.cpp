@@ -3,20 +3,31 @@
 
 #include <ros/console.h>
 #include <ros/init.h>  // ok()
+#include <tbb/concurrent_queue.h>
 #include <tbb/enumerable_thread_specific.h>
 #include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#include "motion_primitives/polynomial_kernels.h"
 namespace motion_primitives {
 
 double Elapsed(const boost::timer::cpu_timer& timer) noexcept {
   return timer.elapsed().wall / 1e9;
 }
 
-bool StatePosWithin(const Eigen::VectorXd& p1, const Eigen::VectorXd& p2,
+bool StatePosWithin(const Eigen::Ref<const Eigen::VectorXd>& p1,
+                    const Eigen::Ref<const Eigen::VectorXd>& p2,
                     int spatial_dim, double d) noexcept {
   return (p1.head(spatial_dim) - p2.head(spatial_dim)).squaredNorm() < (d * d);
 }
 
-bool StateVelWithin(const Eigen::VectorXd& p1, const Eigen::VectorXd& p2,
+bool StateVelWithin(const Eigen::Ref<const Eigen::VectorXd>& p1,
+                    const Eigen::Ref<const Eigen::VectorXd>& p2,
                     int spatial_dim, double d) noexcept {
   return (p1.segment(spatial_dim, spatial_dim) -
           p2.segment(spatial_dim, spatial_dim))
@@ -25,35 +36,223 @@ bool StateVelWithin(const Eigen::VectorXd& p1, const Eigen::VectorXd& p2,
 
 GraphSearch::GraphSearch(const MotionPrimitiveGraph& graph,
                          const kr_planning_msgs::VoxelMap& voxel_map,
-                         const Option& options)
-    : graph_(graph), voxel_map_(voxel_map), options_(options) {
-  map_dims_[0] = voxel_map_.dim.x;
-  map_dims_[1] = voxel_map_.dim.y;
-  map_dims_[2] = voxel_map_.dim.z;
-  map_origin_[0] = voxel_map_.origin.x;
-  map_origin_[1] = voxel_map_.origin.y;
-  map_origin_[2] = voxel_map_.origin.z;
+                         const Option& options,
+                         std::shared_ptr<SearchContext> context)
+    : graph_(graph), options_(options), context_(std::move(context)) {
+  AdoptContext(&graph);
+  InitMap(voxel_map, {});
+}
+
+GraphSearch::GraphSearch(const MotionPrimitiveGraph& graph,
+                         const VoxelMapView& map_view, const Option& options,
+                         std::shared_ptr<SearchContext> context)
+    : graph_(graph), options_(options), context_(std::move(context)) {
+  AdoptContext(&graph);
+  InitMap(*map_view.map, map_view.cleared);
+}
+
+void GraphSearch::AdoptContext(const MotionPrimitiveGraph* graph_identity) {
+  if (!context_) context_ = std::make_shared<SearchContext>();
+  // The caller's graph object (not our copy) is the identity that survives
+  // across queries. Heuristics only transfer if they were computed toward
+  // the same goal on the same graph; collision verdicts only depend on the
+  // graph (the map owner reports map changes separately).
+  if (context_->graph != graph_identity) {
+    context_->heuristic_cache.clear();
+    context_->collision_cache.clear();
+    context_->goal_state = options_.goal_state;
+    context_->graph = graph_identity;
+  } else if (context_->goal_state.size() != options_.goal_state.size() ||
+             !(context_->goal_state == options_.goal_state)) {
+    context_->heuristic_cache.clear();
+    context_->goal_state = options_.goal_state;
+  }
+  // No search is running on this context here, so erasing is safe.
+  context_->ApplyPendingInvalidations();
+  // Borrow the pooled search storage; its tables keep their high-water
+  // capacity across queries and are cleared per search, not reallocated.
+  if (!context_->scratch)
+    context_->scratch = std::make_unique<SearchScratch>();
+  scratch_ = context_->scratch.get();
+}
+
+// Out of line because SearchScratch is incomplete where SearchContext is
+// defined.
+GraphSearch::SearchContext::~SearchContext() = default;
+
+void GraphSearch::SearchContext::MarkDirty(const std::vector<DirtyBox>& boxes) {
+  std::lock_guard<std::mutex> lock(dirty_mutex_);
+  pending_dirty_.insert(pending_dirty_.end(), boxes.begin(), boxes.end());
+}
+
+void GraphSearch::SearchContext::DropCollisionCache() {
+  std::lock_guard<std::mutex> lock(dirty_mutex_);
+  drop_collision_cache_ = true;
+  pending_dirty_.clear();
+}
+
+void GraphSearch::SearchContext::ApplyPendingInvalidations() {
+  std::vector<DirtyBox> boxes;
+  bool drop = false;
+  {
+    std::lock_guard<std::mutex> lock(dirty_mutex_);
+    boxes.swap(pending_dirty_);
+    drop = drop_collision_cache_;
+    drop_collision_cache_ = false;
+  }
+  if (drop) {
+    collision_cache.clear();
+    return;
+  }
+  if (boxes.empty()) return;
+  for (auto it = collision_cache.begin(); it != collision_cache.end();) {
+    const auto& verdict = it->second;
+    bool stale = false;
+    for (const auto& [box_min, box_max] : boxes) {
+      if ((verdict.aabb_min.array() <= box_max.array()).all() &&
+          (box_min.array() <= verdict.aabb_max.array()).all()) {
+        stale = true;
+        break;
+      }
+    }
+    it = stale ? collision_cache.unsafe_erase(it) : std::next(it);
+  }
+}
+
+void GraphSearch::InitMap(const kr_planning_msgs::VoxelMap& voxel_map,
+                          const std::vector<int>& cleared) {
+  map_dims_[0] = voxel_map.dim.x;
+  map_dims_[1] = voxel_map.dim.y;
+  map_dims_[2] = voxel_map.dim.z;
+  map_origin_[0] = voxel_map.origin.x;
+  map_origin_[1] = voxel_map.origin.y;
+  map_origin_[2] = voxel_map.origin.z;
+  map_resolution_ = voxel_map.resolution;
   heuristic_types_map_["zero"] =
       &motion_primitives::GraphSearch::ComputeHeuristicZero;
   heuristic_types_map_["ruckig_bvp"] = &GraphSearch::ComputeHeuristicRuckigBVP;
   heuristic_types_map_["min_time"] = &GraphSearch::ComputeHeuristicMinTime;
   heuristic_types_map_["eth_bvp"] = &GraphSearch::ComputeHeuristicETHBVP;
+  heuristic_types_map_["min_time_bvp"] =
+      &GraphSearch::ComputeHeuristicMinTimeBVP;
   ROS_INFO("Heuristic type: %s", options_.heuristic.c_str());
   ROS_INFO("Access graph: %d", options_.access_graph);
   if (heuristic_types_map_.count(options_.heuristic) == 0) {
     ROS_ERROR("Heuristic type invalid");
   }
+  // Resolve the member function pointer once; the expansion loop calls the
+  // heuristic per successor and must not repeat the map lookup.
+  heuristic_fn_ = heuristic_types_map_.at(options_.heuristic);
+  batch_heuristic_ =
+      options_.heuristic == "min_time" || options_.heuristic == "zero";
+  // The analytic heuristics are cheaper than a cache lookup; only the ones
+  // that run a full BVP solve per call are worth memoizing.
+  cache_heuristic_ =
+      options_.heuristic == "ruckig_bvp" || options_.heuristic == "eth_bvp";
+  // No-op if the graph was loaded with tables at this step size already.
+  graph_.precompute_sample_tables(options_.step_size);
+
+  map_stride_y_ = map_dims_[0];
+  map_stride_z_ = map_dims_[0] * map_dims_[1];
+  // Pack occupancy into one bit per voxel so collision probes stay cache
+  // resident (~1/8 the footprint of VoxelMap.data).
+  const size_t num_voxels = voxel_map.data.size();
+  occupancy_bitmap_.assign((num_voxels + 63) / 64, 0);
+  for (size_t i = 0; i < num_voxels; ++i) {
+    const auto v = voxel_map.data[i];
+    const bool occupied = options_.unknown_is_free ? (v > 0) : (v != 0);
+    if (occupied)
+      occupancy_bitmap_[i >> 6] |= (static_cast<uint64_t>(1) << (i & 63));
+  }
+  // Overlay: voxels the caller wants treated as free (robot footprint etc.)
+  // are cleared in our packed copy, leaving the shared map untouched.
+  for (const int idx : cleared) {
+    if (idx >= 0 && static_cast<size_t>(idx) < num_voxels)
+      occupancy_bitmap_[idx >> 6] &=
+          ~(static_cast<uint64_t>(1) << (idx & 63));
+  }
+  if (options_.use_esdf) build_esdf();
+}
+
+void GraphSearch::build_esdf() {
+  // Two-pass chamfer transform with unit cost on all 26 neighbor offsets,
+  // which computes the Chebyshev distance to the nearest occupied voxel.
+  const int nx = std::max(map_dims_[0], 1);
+  const int ny = std::max(map_dims_[1], 1);
+  const int nz = spatial_dim() > 2 ? std::max(map_dims_[2], 1) : 1;
+  constexpr uint8_t kMaxClearance = 255;
+  esdf_.assign(static_cast<size_t>(nx) * ny * nz, kMaxClearance);
+  for (size_t i = 0; i < esdf_.size(); ++i) {
+    if (occupancy_bitmap_[i >> 6] & (static_cast<uint64_t>(1) << (i & 63)))
+      esdf_[i] = 0;
+  }
+  // Seed the map boundary at distance 1 (the nearest out-of-map voxel is
+  // one step away). The per-sample collision check rejects out-of-map
+  // positions, so the clearance must also bound the distance to the map
+  // edge or the skipping below could leap over a stretch of a primitive
+  // that exits and re-enters the map. The z faces only count in 3D; in 2D
+  // the z axis is collapsed and never probed.
+  const auto seed_boundary = [this](int x, int y, int z) {
+    const int idx = x + map_stride_y_ * y + map_stride_z_ * z;
+    if (esdf_[idx] > 1) esdf_[idx] = 1;
+  };
+  for (int z = 0; z < nz; z++) {
+    for (int y = 0; y < ny; y++) {
+      seed_boundary(0, y, z);
+      seed_boundary(nx - 1, y, z);
+    }
+    for (int x = 0; x < nx; x++) {
+      seed_boundary(x, 0, z);
+      seed_boundary(x, ny - 1, z);
+    }
+  }
+  if (spatial_dim() > 2) {
+    for (int y = 0; y < ny; y++) {
+      for (int x = 0; x < nx; x++) {
+        seed_boundary(x, y, 0);
+        seed_boundary(x, y, nz - 1);
+      }
+    }
+  }
+
+  const auto relax = [&](int x, int y, int z, int dir) {
+    const int idx = x + map_stride_y_ * y + map_stride_z_ * z;
+    int best = esdf_[idx];
+    if (best == 0) return;
+    for (int dz = -1; dz <= 1; dz++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          // Only look at neighbors already updated in this pass direction.
+          const int order = dz * 9 + dy * 3 + dx;
+          if (dir * order >= 0) continue;
+          const int xn = x + dx, yn = y + dy, zn = z + dz;
+          if (xn < 0 || xn >= nx || yn < 0 || yn >= ny || zn < 0 || zn >= nz)
+            continue;
+          const int cand =
+              esdf_[xn + map_stride_y_ * yn + map_stride_z_ * zn] + 1;
+          if (cand < best) best = cand;
+        }
+      }
+    }
+    esdf_[idx] = best;
+  };
+
+  for (int z = 0; z < nz; z++)
+    for (int y = 0; y < ny; y++)
+      for (int x = 0; x < nx; x++) relax(x, y, z, 1);
+  for (int z = nz - 1; z >= 0; z--)
+    for (int y = ny - 1; y >= 0; y--)
+      for (int x = nx - 1; x >= 0; x--) relax(x, y, z, -1);
 }
 
 Eigen::Vector3i GraphSearch::get_indices_from_position(
     const Eigen::Vector3d& position) const {
-  return floor(((position - map_origin_) / voxel_map_.resolution).array())
+  return floor(((position - map_origin_) / map_resolution_).array())
       .cast<int>();
 }
 
 int GraphSearch::get_linear_indices(const Eigen::Vector3i& indices) const {
-  return indices[0] + map_dims_[0] * indices[1] +
-         map_dims_[0] * map_dims_[1] * indices[2];
+  return indices[0] + map_stride_y_ * indices[1] + map_stride_z_ * indices[2];
 }
 
 bool GraphSearch::is_valid_indices(const Eigen::Vector3i& indices) const {
@@ -67,9 +266,18 @@ bool GraphSearch::is_valid_indices(const Eigen::Vector3i& indices) const {
 
 bool GraphSearch::is_free_and_valid_indices(
     const Eigen::Vector3i& indices) const {
-  return ((is_valid_indices(indices) &&
-           voxel_map_.data[get_linear_indices(indices)] <= 0));
-  // 0 is free, -1 is unknown. TODO(laura): add back unknown_is_free option
+  // Fused bounds check: the unsigned compare catches negative indices too.
+  for (int i = 0; i < spatial_dim(); ++i) {
+    if (static_cast<uint32_t>(indices[i]) >=
+        static_cast<uint32_t>(map_dims_[i])) {
+      return false;
+    }
+  }
+  // How unknown (-1) voxels are treated was folded into the bitmap at
+  // construction via options_.unknown_is_free.
+  const auto idx = static_cast<size_t>(get_linear_indices(indices));
+  return (occupancy_bitmap_[idx >> 6] &
+          (static_cast<uint64_t>(1) << (idx & 63))) == 0;
 }
 
 bool GraphSearch::is_free_and_valid_position(Eigen::VectorXd position) const {
@@ -81,22 +289,100 @@ bool GraphSearch::is_free_and_valid_position(Eigen::VectorXd position) const {
   return is_free_and_valid_indices(get_indices_from_position(position));
 }
 
+bool GraphSearch::are_positions_collision_free(
+    const Eigen::MatrixXd& samples,
+    const Eigen::Ref<const Eigen::VectorXd>& offset, double step_size) const {
+  Eigen::Vector3d position;
+  position.z() = options_.fixed_z;
+  // Upper bound on the distance covered between consecutive samples (the
+  // per-axis velocity bound holds in every dimension simultaneously).
+  const double max_sample_dist =
+      graph_.max_state()(1) * std::sqrt(spatial_dim()) * step_size;
+  for (int i = 0; i < samples.cols();) {
+    position.head(spatial_dim()) = samples.col(i) + offset;
+    const Eigen::Vector3i indices = get_indices_from_position(position);
+    if (!is_free_and_valid_indices(indices)) return false;
+    int advance = 1;
+    if (!esdf_.empty()) {
+      // All samples within the clearance sphere are free; skip them. The -1
+      // keeps a one-voxel margin for the discretization of the sample itself.
+      const double clearance =
+          (esdf_clearance(indices) - 1) * map_resolution_;
+      advance = std::max(1, static_cast<int>(clearance / max_sample_dist));
+    }
+    i += advance;
+  }
+  return true;
+}
+
 bool GraphSearch::is_mp_collision_free(
     const std::shared_ptr<MotionPrimitive> mp, double step_size) const {
+  profiler_.count_collision_check();
   const Eigen::MatrixXd samples = mp->sample_positions(step_size);
-  for (int i = 0; i < samples.cols(); ++i) {
-    if (!is_free_and_valid_position(samples.col(i))) {
-      return false;
+  return are_positions_collision_free(
+      samples, Eigen::VectorXd::Zero(spatial_dim()), step_size);
+}
+
+bool GraphSearch::is_mp_collision_free_translated(
+    const MotionPrimitive& mp,
+    const Eigen::Ref<const Eigen::VectorXd>& new_start,
+    double step_size) const {
+  const Eigen::VectorXd offset =
+      new_start.head(spatial_dim()) - mp.start_state_.head(spatial_dim());
+  if (graph_.has_sample_tables(step_size) && mp.start_index_ >= 0 &&
+      mp.end_index_ >= 0) {
+    // The verdict only depends on the edge and the translated start, so in
+    // steady-state replans most probes hit the cross-query cache. The key
+    // quantizes the start to the world voxel lattice; starts sharing a cell
+    // share the verdict, an approximation within one sampling step.
+    SearchContext::CollisionKey key;
+    key.mp_index = graph_.edges_(mp.end_index_, mp.start_index_);
+    Eigen::Vector3d position;
+    position.z() = options_.fixed_z;
+    position.head(spatial_dim()) = new_start.head(spatial_dim());
+    key.cell =
+        (position / map_resolution_).array().floor().cast<int>().matrix();
+    const auto it = context_->collision_cache.find(key);
+    if (it != context_->collision_cache.end()) {
+      profiler_.count_collision_cache_hit();
+      return it->second.free;
     }
+    profiler_.count_collision_check();
+    // Cached sample offsets from precompute_sample_tables; the collision
+    // check reduces to adding the node position and probing the voxel map.
+    const auto& samples = graph_.sample_table(mp.end_index_, mp.start_index_);
+    const bool free = are_positions_collision_free(samples, offset, step_size);
+    SearchContext::CollisionVerdict verdict;
+    verdict.free = free;
+    // World AABB of the probed samples, padded one voxel so boundary
+    // effects (sample discretization, esdf-skipped stretches) stay inside.
+    Eigen::Vector3d lo = Eigen::Vector3d::Constant(options_.fixed_z);
+    Eigen::Vector3d hi = lo;
+    lo.head(spatial_dim()) = samples.rowwise().minCoeff() + offset;
+    hi.head(spatial_dim()) = samples.rowwise().maxCoeff() + offset;
+    verdict.aabb_min = (lo.array() - map_resolution_).cast<float>().matrix();
+    verdict.aabb_max = (hi.array() + map_resolution_).cast<float>().matrix();
+    context_->collision_cache.emplace(key, verdict);
+    return free;
   }
-  return true;
+  profiler_.count_collision_check();
+  // No table for this step size: fall back to clone+translate, which also
+  // computes the profile RuckigMotionPrimitive needs before sampling.
+  auto copy = mp.clone();
+  copy->translate(new_start);
+  const Eigen::MatrixXd samples = copy->sample_positions(step_size);
+  return are_positions_collision_free(
+      samples, Eigen::VectorXd::Zero(spatial_dim()), step_size);
 }
 
-std::size_t VectorXdHash::operator()(const Eigen::VectorXd& vd) const noexcept {
+std::size_t VectorXdHash::operator()(
+    const Eigen::Ref<const Eigen::VectorXd>& vd) const noexcept {
   using std::size_t;
 
-  // allow sufficiently close state to map to the same hash value
-  const Eigen::VectorXi v = (vd * 100).cast<int>();
+  // allow sufficiently close state to map to the same hash value; the fixed
+  // capacity keeps the quantized copy on the stack
+  const Eigen::Matrix<int, Eigen::Dynamic, 1, Eigen::ColMajor, kMaxStateDim, 1>
+      v = (vd * 100).cast<int>();
 
   size_t seed = 0;
   for (size_t i = 0; i < static_cast<size_t>(v.size()); ++i) {
@@ -106,8 +392,10 @@ std::size_t VectorXdHash::operator()(const Eigen::VectorXd& vd) const noexcept {
   return seed;
 }
 
-auto GraphSearch::ExpandSingleNode(int index1, int index2, const Node& node,
-                                   const State& goal_state) const
+auto GraphSearch::GenerateSuccessor(int index1, int index2, const Node& node,
+                                    const State& goal_state,
+                                    const StateSet* visited,
+                                    bool defer_heuristic) const
     -> std::pair<bool, Node> {
   Node next_node;
   auto failure = std::make_pair(false, next_node);
@@ -115,23 +403,63 @@ auto GraphSearch::ExpandSingleNode(int index1, int index2, const Node& node,
   // Check if requested motion primitive exists in the graph
   if (!graph_.HasEdge(index1, index2)) return failure;
 
-  auto mp = graph_.get_mp_between_indices(index1, index2)->clone();
-  mp->translate(node.state);
+  // Translating a primitive only shifts its positions, so instead of
+  // clone()+translate() (a shared_ptr allocation plus full Eigen copies per
+  // candidate edge) we read the stored primitive in place and apply the
+  // position offset where needed. The actual translated primitive is only
+  // materialized during path recovery (GetPrimitiveBetween).
+  const auto& mp = graph_.get_mp_ref_between_indices(index1, index2);
+  State next_state = mp.end_state_;
+  next_state.head(spatial_dim()) +=
+      node.state.head(spatial_dim()) - mp.start_state_.head(spatial_dim());
 
-  // Check if already visited
-  if (visited_states_.find(mp->end_state_) != visited_states_.cend())
+  // Cheap rejects before any real work is spent on the successor. First:
+  // an end position outside the map AABB is guaranteed to fail the
+  // collision check once sampling reaches it.
+  Eigen::Vector3d end_position;
+  end_position.z() = options_.fixed_z;
+  end_position.head(spatial_dim()) = next_state.head(spatial_dim());
+  if (!is_valid_indices(get_indices_from_position(end_position)))
     return failure;
 
+  // Optional goal-directed prune (see Option::prune_goal_retreat).
+  if (options_.prune_goal_retreat >= 0) {
+    const double next_dist = (next_state.head(spatial_dim()) -
+                              goal_state.head(spatial_dim()))
+                                 .lpNorm<Eigen::Infinity>();
+    const double curr_dist = (node.state.head(spatial_dim()) -
+                              goal_state.head(spatial_dim()))
+                                 .lpNorm<Eigen::Infinity>();
+    if (next_dist > curr_dist + options_.prune_goal_retreat) return failure;
+  }
+
+  // Cascade corridor: discard successors outside the coarse-path tube
+  // before spending anything on the visited or collision checks.
+  if (!in_corridor(next_state.head(spatial_dim()))) return failure;
+
+  // Check if already visited
+  if (visited != nullptr && visited->contains(next_state)) return failure;
+
   // Then check if its collision free
-  if (!is_mp_collision_free(mp, options_.step_size)) return failure;
+  if (!is_mp_collision_free_translated(mp, node.state, options_.step_size))
+    return failure;
 
   // This is a good next node
   next_node.state_index = index1;
-  next_node.state = mp->end_state_;
-  next_node.motion_cost = node.motion_cost + mp->cost_;
-  next_node.heuristic_cost = ComputeHeuristic(mp->end_state_, goal_state);
+  next_node.state = next_state;
+  next_node.motion_cost = node.motion_cost + mp.cost_;
+  if (!defer_heuristic) {
+    next_node.heuristic_cost =
+        heuristic_inflation_ * ComputeHeuristic(next_state, goal_state);
+  }
   return std::make_pair(true, next_node);
 }
+
+auto GraphSearch::ExpandSingleNode(int index1, int index2, const Node& node,
+                                   const State& goal_state) const
+    -> std::pair<bool, Node> {
+  return GenerateSuccessor(index1, index2, node, goal_state, &scratch_->visited);
+}
 auto GraphSearch::Expand(const Node& node, const State& goal_state) const
     -> std::vector<Node> {
   std::vector<Node> nodes;
@@ -139,12 +467,18 @@ auto GraphSearch::Expand(const Node& node, const State& goal_state) const
 
   const int state_index = graph_.NormIndex(node.state_index);
 
-  for (int i = 0; i < graph_.num_tiled_states(); ++i) {
-    const auto& [success, next_node] =
-        ExpandSingleNode(i, state_index, node, goal_state);
+  // Iterate only the actual successors of this vertex instead of probing
+  // every row of the dense (mostly -1) edge matrix.
+  for (auto it = graph_.successors_begin(state_index);
+       it != graph_.successors_end(state_index); ++it) {
+    const auto& [success, next_node] = GenerateSuccessor(
+        it->end_index, state_index, node, goal_state, &scratch_->visited, true);
     if (success) nodes.push_back(next_node);
   }
 
+  // Heuristics for the whole surviving successor set in one vectorized pass
+  // (falls back to the scalar path for the BVP heuristics).
+  ApplyHeuristics(&nodes, goal_state);
   return nodes;
 }
 
@@ -152,26 +486,36 @@ auto GraphSearch::ExpandPar(const Node& node, const State& goal_state) const
     -> std::vector<Node> {
   const int state_index = graph_.NormIndex(node.state_index);
 
-  using PrivVec = tbb::enumerable_thread_specific<std::vector<Node>>;
-  PrivVec priv_nodes;
+  // Thread-local buffers from the scratch pool; each keeps its capacity
+  // across expansions (and searches) instead of growing from empty.
+  auto& priv_nodes = scratch_->expand_tls;
 
-  tbb::parallel_for(tbb::blocked_range<int>(0, graph_.num_tiled_states()),
-                    [&, this](const tbb::blocked_range<int>& r) {
-                      auto& local = priv_nodes.local();
+  // Range over the CSR successor list so the TBB partitioner load-balances
+  // over real work instead of mostly-empty edge matrix rows.
+  const auto* successors = graph_.successors_begin(state_index);
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, graph_.num_successors(state_index)),
+      [&, this](const tbb::blocked_range<int>& r) {
+        auto& local = priv_nodes.local();
 
-                      for (int i = r.begin(); i < r.end(); ++i) {
-                        const auto& [success, next_node] =
-                            ExpandSingleNode(i, state_index, node, goal_state);
-                        if (success) local.push_back(std::move(next_node));
-                      }
-                    });
+        for (int i = r.begin(); i < r.end(); ++i) {
+          const auto& [success, next_node] =
+              GenerateSuccessor(successors[i].end_index, state_index, node,
+                                goal_state, &scratch_->visited, true);
+          if (success) local.push_back(std::move(next_node));
+        }
+      });
 
   // combine
   std::vector<Node> nodes;
   nodes.reserve(64);
-  for (const auto& each : priv_nodes) {
+  for (auto& each : priv_nodes) {
     nodes.insert(nodes.end(), each.begin(), each.end());
+    each.clear();  // keep the allocation for the next expansion
   }
+  // Heuristics batched after the merge; the vectorized pass beats scattering
+  // scalar calls across the workers.
+  ApplyHeuristics(&nodes, goal_state);
   return nodes;
 }
 
@@ -224,9 +568,10 @@ auto GraphSearch::RecoverPath(const PathHistory& history,
 
 double GraphSearch::ComputeHeuristicMinTime(const State& v,
                                             const State& goal_state) const {
-  const Eigen::VectorXd x = (v - goal_state).head(spatial_dim());
   // TODO(laura) [theoretical] needs a lot of improvement.
-  return graph_.rho() * x.lpNorm<Eigen::Infinity>() / graph_.max_state()(1);
+  return graph_.rho() *
+         (v - goal_state).head(spatial_dim()).lpNorm<Eigen::Infinity>() /
+         graph_.max_state()(1);
 }
 
 double GraphSearch::ComputeHeuristicRuckigBVP(const State& v,
@@ -250,16 +595,80 @@ double GraphSearch::ComputeHeuristicZero(const State& v,
   return 0;
 }
 
+double GraphSearch::ComputeHeuristicMinTimeBVP(const State& v,
+                                               const State& goal_state) const {
+  // Any time-optimal profile needs at least |dp|/vmax per axis to cover the
+  // distance and |dv|/amax to change velocity, and every axis must finish,
+  // so the max over axes lower-bounds the true (and the Ruckig) duration.
+  // This keeps the heuristic admissible at nanoseconds per call instead of
+  // a full ruckig::Ruckig<3>::calculate per successor.
+  const double vmax = graph_.max_state()(1);
+  const double amax = graph_.max_state().size() > 2 ? graph_.max_state()(2) : 0;
+  double t = 0;
+  for (int dim = 0; dim < spatial_dim(); ++dim) {
+    const double dp = std::abs(goal_state(dim) - v(dim));
+    t = std::max(t, dp / vmax);
+    if (amax > 0) {
+      const double dv = std::abs(goal_state(spatial_dim() + dim) -
+                                 v(spatial_dim() + dim));
+      t = std::max(t, dv / amax);
+    }
+  }
+  return graph_.rho() * t;
+}
+
 double GraphSearch::ComputeHeuristic(const State& v,
                                      const State& goal_state) const {
-  auto func_pointer = heuristic_types_map_.at(options_.heuristic);
-  return (this->*func_pointer)(v, goal_state);
+  profiler_.count_heuristic_call();
+  if (!cache_heuristic_) return (this->*heuristic_fn_)(v, goal_state);
+  auto& cache = context_->heuristic_cache;
+  const auto it = cache.find(v);
+  if (it != cache.end()) return it->second;
+  const double h = (this->*heuristic_fn_)(v, goal_state);
+  cache.insert({v, h});
+  return h;
+}
+
+Eigen::VectorXd GraphSearch::ComputeHeuristicBatch(
+    const Eigen::MatrixXd& states, const State& goal_state) const {
+  const int n = static_cast<int>(states.cols());
+  if (batch_heuristic_) {
+    profiler_.count_heuristic_calls(n);
+    if (heuristic_fn_ == &GraphSearch::ComputeHeuristicZero)
+      return Eigen::VectorXd::Zero(n);
+    // min_time for every column at once: rho * ||p - g||_inf / vmax reduces
+    // to an abs-diff and a columnwise max over the position rows, one
+    // SIMD-friendly pass instead of n lpNorm calls.
+    return (states.topRows(spatial_dim()).colwise() -
+            goal_state.head(spatial_dim()))
+               .cwiseAbs()
+               .colwise()
+               .maxCoeff()
+               .transpose() *
+           (graph_.rho() / graph_.max_state()(1));
+  }
+  // BVP heuristics do real work per state; go through the scalar (and
+  // memoizing) path.
+  Eigen::VectorXd out(n);
+  for (int i = 0; i < n; ++i)
+    out(i) = ComputeHeuristic(states.col(i), goal_state);
+  return out;
+}
+
+void GraphSearch::ApplyHeuristics(std::vector<Node>* nodes,
+                                  const State& goal_state) const {
+  if (nodes->empty()) return;
+  Eigen::MatrixXd states(graph_.state_dim(), nodes->size());
+  for (size_t i = 0; i < nodes->size(); ++i) states.col(i) = (*nodes)[i].state;
+  const Eigen::VectorXd h = ComputeHeuristicBatch(states, goal_state);
+  for (size_t i = 0; i < nodes->size(); ++i)
+    (*nodes)[i].heuristic_cost = heuristic_inflation_ * h(i);
 }
 
 auto GraphSearch::Search()
     -> std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> {
-  timings_.clear();
-  visited_states_.clear();
+  profiler_.clear();
+  scratch_->visited.clear();
 
   if (options_.start_state.size() != graph_.state_dim() ||
       options_.goal_state.size() != graph_.state_dim()) {
@@ -280,24 +689,98 @@ auto GraphSearch::Search()
     ROS_WARN_STREAM("Goal is not free");
     return {};
   }
-  // > for min heap
-  auto node_cmp = [](const Node& n1, const Node& n2) {
-    return n1.total_cost() > n2.total_cost();
-  };
-  using MinHeap =
-      std::priority_queue<Node, std::vector<Node>, decltype(node_cmp)>;
+  if (options_.hda_star) return SearchHDA();
 
-  MinHeap pq{node_cmp};
-  // Shortest path history, stores the parent node of a particular mp (int)
-  // PathHistory history;
+  boost::timer::cpu_timer search_timer;
+  double inflation = std::max(1.0, options_.heuristic_inflation);
+  std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> best{};
+  bool best_is_partial = false;
+  while (true) {
+    scratch_->visited.clear();
+    heuristic_inflation_ = inflation;
+    bool result_is_partial = false;
+    auto result = SearchOnce(search_timer, &result_is_partial);
+    // A deadline-truncated pass ends in a never-searched leg whose cost is
+    // not comparable to a complete path's, so a partial result may only
+    // stand in when nothing complete exists, never replace it.
+    if (!result.first.empty()) {
+      const bool better =
+          best.first.empty() || (best_is_partial && !result_is_partial) ||
+          (best_is_partial == result_is_partial && result.second < best.second);
+      if (better) {
+        best = std::move(result);
+        best_is_partial = result_is_partial;
+      }
+    }
+    const bool deadline_passed =
+        options_.deadline > 0 && Elapsed(search_timer) >= options_.deadline;
+    if (inflation <= 1.0 || deadline_passed || cancelled() ||
+        best.first.empty())
+      break;
+    // Anytime refinement: re-run with a tighter bound while budget remains.
+    // The heuristic cache and warmed-up table capacities make reruns much
+    // cheaper than the first pass.
+    inflation = std::max(1.0, inflation / 2);
+    ROS_INFO_STREAM("Anytime refinement with inflation " << inflation);
+  }
+  heuristic_inflation_ = 1.0;
+  return best;
+}
+
+auto GraphSearch::SearchOnce(const boost::timer::cpu_timer& search_timer,
+                             bool* partial)
+    -> std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> {
+  *partial = false;
+  // Open list and history borrowed from the scratch pool: cleared, not
+  // reallocated, so consecutive replans reuse their high-water capacity.
+  auto& pq = scratch_->queue;
+  pq.clear();
+  auto& history = scratch_->history;
+  history.clear();
 
-  auto [nodes, history] = AccessGraph(options_.start_state);
+  const auto nodes = [&] {
+    SearchProfiler::ScopedPhase phase(profiler_,
+                                      SearchProfiler::kAccessGraph);
+    return AccessGraph(options_.start_state, &history);
+  }();
   for (auto node : nodes) {
     pq.push(node);
+    profiler_.count_queue_push();
   }
 
+  // The expanded node closest to the goal by heuristic, used for the
+  // partial-path return when the deadline expires mid-search.
+  Node best_partial;
+  bool have_partial = false;
+
   bool ros_ok = ros::ok() || !options_.using_ros;
   while (!pq.empty() && ros_ok) {
+    if (cancelled()) {
+      // Whoever cancelled us is about to discard the result, so skip the
+      // partial-path recovery the deadline branch does.
+      ROS_WARN_STREAM("Search cancelled");
+      return {};
+    }
+    if (options_.deadline > 0 && Elapsed(search_timer) >= options_.deadline) {
+      ROS_WARN_STREAM("Search deadline reached");
+      if (have_partial && best_partial.motion_cost > 0) {
+        // RecoverPath appends a computed trajectory toward the exact goal,
+        // so even the partial path gives the tracker something to fly —
+        // but that leg was synthesized, never searched, so probe it before
+        // offering the path as flyable.
+        auto partial_path = RecoverPath(history, best_partial);
+        if (!partial_path.first.empty() &&
+            !is_mp_collision_free(partial_path.first.back(),
+                                  options_.step_size)) {
+          ROS_WARN_STREAM("Partial path goal leg is in collision, discarding");
+          return {};
+        }
+        ROS_WARN_STREAM("Returning best partial path");
+        *partial = true;
+        return partial_path;
+      }
+      return {};
+    }
     Node curr_node = pq.top();
 
     // Check if we are close enough to the end
@@ -309,56 +792,243 @@ auto GraphSearch::Search()
         ROS_WARN_STREAM("Motion primitive planning successful");
       ROS_INFO_STREAM("== pq: " << pq.size());
       ROS_INFO_STREAM("== hist: " << history.size());
-      ROS_INFO_STREAM("== nodes: " << visited_states_.size());
+      ROS_INFO_STREAM("== nodes: " << scratch_->visited.size());
       return RecoverPath(history, curr_node);
     }
 
     pq.pop();
+    profiler_.count_queue_pop();
 
-    // Due to the immutability of std::priority_queue, we have no way of
-    // modifying the priority of an element in the queue. Therefore, when we
-    // push the next node into the queue, there might be duplicated nodes with
-    // the same state but different costs. This could cause us to expand the
-    // same state multiple times.
-    // Although this does not affect the correctness of the implementation
-    // (since the nodes are correctly sorted), it might be slower to repeatedly
-    // expanding visited states. The timing suggest more than 80% of the time
-    // is spent on the Expand(node) call. Thus, we will check here if this state
-    // has been visited and skip if it has. This will save around 20%
-    // computation.
-    if (visited_states_.find(curr_node.state) != visited_states_.cend()) {
+    // The open list has no decrease-key; when we push the next node into the
+    // queue, there might be duplicated (stale) entries with the same state
+    // but different costs (see OpenList). Skipping already-visited states
+    // here suppresses them at the cost of a cheap 16-byte pop.
+    if (scratch_->visited.contains(curr_node.state)) {
       continue;
     }
     // add current state to visited
-    visited_states_.insert(curr_node.state);
-
-    const auto next_nodes = options_.parallel_expand
-                                ? ExpandPar(curr_node, options_.goal_state)
-                                : Expand(curr_node, options_.goal_state);
-    for (const auto& next_node : next_nodes) {
-      // this is the best cost reaching this state (next_node) so far
-      // could be inf if this state has never been visited
-      const auto best_cost = history[next_node.state].best_cost;
-
-      // compare reaching next_node from curr_node and mp to best cost
-      if (next_node.motion_cost < best_cost) {
-        pq.emplace(next_node);
-        history[next_node.state] = {curr_node, next_node.motion_cost};
+    scratch_->visited.insert(curr_node.state);
+    if (!have_partial ||
+        curr_node.heuristic_cost < best_partial.heuristic_cost) {
+      best_partial = curr_node;
+      have_partial = true;
+    }
+
+    profiler_.count_expansion();
+    const auto next_nodes = [&] {
+      SearchProfiler::ScopedPhase phase(profiler_, SearchProfiler::kExpand);
+      return options_.parallel_expand
+                 ? ExpandPar(curr_node, options_.goal_state)
+                 : Expand(curr_node, options_.goal_state);
+    }();
+    {
+      SearchProfiler::ScopedPhase phase(profiler_,
+                                        SearchProfiler::kBookkeeping);
+      for (const auto& next_node : next_nodes) {
+        // this is the best cost reaching this state (next_node) so far
+        // could be inf if this state has never been visited
+        const auto best_cost = history[next_node.state].best_cost;
+
+        // compare reaching next_node from curr_node and mp to best cost
+        if (next_node.motion_cost < best_cost) {
+          pq.push(next_node);
+          profiler_.count_queue_push();
+          history[next_node.state] = {curr_node, next_node.motion_cost};
+        }
       }
     }
+    profiler_.record_history_size(history.size());
   }
   if (pq.empty()) ROS_WARN_STREAM("Priority queue empty, exiting");
   if (!ros_ok) ROS_WARN_STREAM("Exiting because of ROS");
   return {};
 }
 
+auto GraphSearch::SearchHDA()
+    -> std::pair<std::vector<std::shared_ptr<MotionPrimitive>>, double> {
+  const int num_workers =
+      options_.num_threads > 0
+          ? options_.num_threads
+          : static_cast<int>(std::thread::hardware_concurrency());
+
+  // A generated node routed to the worker owning its state, together with
+  // the parent that generated it (the owner writes the history entry).
+  struct Message {
+    Node node;
+    Node parent;
+  };
+  std::vector<tbb::concurrent_queue<Message>> inboxes(num_workers);
+  std::vector<PathHistory> histories;
+  std::vector<StateSet> visited;
+  for (int i = 0; i < num_workers; i++) {
+    histories.emplace_back(1024);
+    visited.emplace_back(1024);
+  }
+  const auto owner = [num_workers](const State& state) {
+    return static_cast<int>(VectorXdHash{}(state) % num_workers);
+  };
+
+  // Token accounting for termination: every generated-but-not-yet-expanded
+  // node holds one in_flight token from the moment it is routed until its
+  // expansion has registered all successor tokens (or it is discarded), so
+  // open-list contents are counted too. in_flight == 0 therefore means no
+  // inbox message, no open-list entry and no node mid-expansion anywhere —
+  // and since creating a token requires holding one, zero is absorbing.
+  std::atomic<int64_t> in_flight{0};
+  std::atomic<bool> done{false};
+  std::atomic<bool> deadline_hit{false};
+  std::mutex incumbent_mutex;
+  Node incumbent;
+  bool have_incumbent = false;
+  boost::timer::cpu_timer search_timer;
+
+  // Seed the workers with the access-graph entry nodes.
+  auto& access_history = scratch_->history;
+  access_history.clear();
+  const auto nodes = AccessGraph(options_.start_state, &access_history);
+  for (const auto& node : nodes) {
+    const auto* info = access_history.find(node.state);
+    const Node parent = info != nullptr ? info->parent_node : node;
+    in_flight++;
+    inboxes[owner(node.state)].push({node, parent});
+  }
+
+  auto worker_fn = [&, this](int wid) {
+    OpenList<Node> open(1024);
+    auto& history = histories[wid];
+    auto& visited_set = visited[wid];
+    Message msg;
+    while (!done.load(std::memory_order_relaxed)) {
+      bool did_work = false;
+      // Ingest routed nodes; the owner alone touches its history, so no
+      // locks are needed on the search bookkeeping.
+      while (inboxes[wid].try_pop(msg)) {
+        did_work = true;
+        auto& info = history[msg.node.state];
+        if (msg.node.motion_cost < info.best_cost) {
+          info.parent_node = msg.parent;
+          info.best_cost = msg.node.motion_cost;
+          // The token travels with the node into the open list; it is only
+          // released once the node is expanded or skipped there.
+          open.push(msg.node);
+          profiler_.count_queue_push();
+        } else {
+          in_flight--;  // discarded, token released
+        }
+      }
+      // Expand at most one node per iteration so inboxes stay drained.
+      while (!open.empty()) {
+        const Node curr = open.top();
+        open.pop();
+        profiler_.count_queue_pop();
+        did_work = true;
+        if (visited_set.contains(curr.state)) {
+          in_flight--;
+          continue;
+        }
+        {
+          std::lock_guard<std::mutex> lock(incumbent_mutex);
+          if (have_incumbent && curr.total_cost() >= incumbent.motion_cost) {
+            in_flight--;
+            continue;
+          }
+        }
+        visited_set.insert(curr.state);
+        if (StatePosWithin(curr.state, options_.goal_state,
+                           graph_.spatial_dim(), options_.distance_threshold)) {
+          std::lock_guard<std::mutex> lock(incumbent_mutex);
+          if (!have_incumbent || curr.motion_cost < incumbent.motion_cost) {
+            incumbent = curr;
+            have_incumbent = true;
+          }
+          in_flight--;
+          continue;
+        }
+        profiler_.count_expansion();
+        const int state_index = graph_.NormIndex(curr.state_index);
+        for (auto it = graph_.successors_begin(state_index);
+             it != graph_.successors_end(state_index); ++it) {
+          const auto& [success, next_node] = GenerateSuccessor(
+              it->end_index, state_index, curr, options_.goal_state,
+              &visited_set);
+          if (!success) continue;
+          in_flight++;
+          inboxes[owner(next_node.state)].push({next_node, curr});
+        }
+        // Release the expanded node's token only after every successor
+        // holds its own, so in_flight can never touch zero with work
+        // pending.
+        in_flight--;
+        break;
+      }
+      if (wid == 0) {
+        if (cancelled()) {
+          done.store(true);
+          break;
+        }
+        if (options_.deadline > 0 &&
+            Elapsed(search_timer) >= options_.deadline) {
+          deadline_hit.store(true);
+          done.store(true);
+          break;
+        }
+        if (in_flight.load() == 0) {
+          // No tokens anywhere: the search is over, either with an
+          // incumbent or exhausted.
+          done.store(true);
+          break;
+        }
+      }
+      if (!did_work) std::this_thread::yield();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_workers);
+  for (int i = 0; i < num_workers; i++) threads.emplace_back(worker_fn, i);
+  for (auto& t : threads) t.join();
+
+  // Merge the partitions back for visualization and path recovery.
+  for (int i = 0; i < num_workers; i++) {
+    visited[i].for_each(
+        [this](const State& state) { scratch_->visited.insert(state); });
+  }
+  if (cancelled()) {
+    ROS_WARN_STREAM("HDA* search cancelled");
+    return {};
+  }
+  if (deadline_hit.load()) {
+    // The incumbent (if any) is a real goal-reaching path, so unlike
+    // SearchOnce there is no partial-path fallback to synthesize here.
+    ROS_WARN_STREAM("HDA* search deadline reached");
+  }
+  if (!have_incumbent) {
+    ROS_WARN_STREAM("HDA* search found no path");
+    return {};
+  }
+  PathHistory combined(4096);
+  for (int i = 0; i < num_workers; i++) {
+    histories[i].for_each([&combined](const State& state,
+                                      const StateInfo& info) {
+      auto& slot = combined[state];
+      if (info.best_cost < slot.best_cost) slot = info;
+    });
+  }
+  return RecoverPath(combined, incumbent);
+}
+
 std::vector<Eigen::VectorXd> GraphSearch::GetVisitedStates() const noexcept {
-  return {visited_states_.cbegin(), visited_states_.cend()};
+  std::vector<Eigen::VectorXd> states;
+  states.reserve(scratch_->visited.size());
+  scratch_->visited.for_each(
+      [&states](const State& state) { states.push_back(state); });
+  return states;
 }
 
-auto GraphSearch::AccessGraph(const State& start_state) const
-    -> std::pair<std::vector<Node>, PathHistory> {
-  PathHistory history;
+auto GraphSearch::AccessGraph(const State& start_state,
+                              PathHistory* history_ptr) const
+    -> std::vector<Node> {
+  auto& history = *history_ptr;
   std::vector<Node> nodes;
   nodes.reserve(64);
   Node start_node;
@@ -366,54 +1036,107 @@ auto GraphSearch::AccessGraph(const State& start_state) const
   start_node.state = start_state;
   start_node.motion_cost = 0.0;
   start_node.heuristic_cost =
+      heuristic_inflation_ *
       ComputeHeuristic(start_node.state, options_.goal_state);
 
   // TODO(Laura) special logic if starting from 0 vel/acc
   if (options_.access_graph) {
-    int counter = 0;
     start_node.state_index = -1;
+    // Candidate entry vertices, cheapest-looking first: computing each one
+    // runs a full trajectory optimization (nonlinear for ETH primitives),
+    // so order by heuristic and stop once enough valid entries exist
+    // instead of paying for every vertex.
+    struct Candidate {
+      int index;
+      State end_state;
+      double heuristic_cost;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(graph_.vertices_.rows() / graph_.num_tiles_ + 1);
     for (int i = 0; i < graph_.vertices_.rows(); i += graph_.num_tiles_) {
-      // TODO(laura) could parallelize
       State end_state = graph_.vertices_.row(i);
       // TODO(laura) decide if this is better than end_state(...) =
       // start_state(...)
       end_state.head(spatial_dim()) += start_state.head(spatial_dim());
-      auto mp =
-          graph_.createMotionPrimitivePtrFromGraph(start_state, end_state);
-      mp->compute(graph_.rho());
-      Node next_node;
-      next_node.state_index = i * graph_.num_tiles_;
-      next_node.state = mp->end_state_;
-      next_node.motion_cost = mp->cost_;
-      next_node.heuristic_cost =
-          ComputeHeuristic(mp->end_state_, options_.goal_state);
-      if (next_node.motion_cost >= 0 && is_mp_collision_free(mp)) {
-        counter++;
-        nodes.push_back(next_node);
-        history[next_node.state] = {start_node, next_node.motion_cost};
-      }
+      candidates.push_back(
+          {i, end_state,
+           heuristic_inflation_ *
+               ComputeHeuristic(end_state, options_.goal_state)});
       if (start_state == end_state) nodes.push_back(start_node);
     }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) {
+                return a.heuristic_cost < b.heuristic_cost;
+              });
+    // Enough entry nodes to seed the search well; with the candidates
+    // sorted, the ones we skip are the least promising.
+    constexpr int kEnoughAccessNodes = 8;
+    const int num_candidates = static_cast<int>(candidates.size());
+    int valid_count = 0;
+    // Batches are sized so early termination can kick in between them
+    // while each one still has enough work to parallelize.
+    const int batch_size =
+        std::max(kEnoughAccessNodes,
+                 static_cast<int>(std::thread::hardware_concurrency()));
+    for (int begin = 0;
+         begin < num_candidates && valid_count < kEnoughAccessNodes;
+         begin += batch_size) {
+      const int end = std::min(begin + batch_size, num_candidates);
+      std::vector<Node> batch_nodes(end - begin);
+      // char, not bool: distinct vector<bool> bits can't be written
+      // concurrently.
+      std::vector<char> batch_valid(end - begin, 0);
+      tbb::parallel_for(
+          tbb::blocked_range<int>(begin, end),
+          [&, this](const tbb::blocked_range<int>& r) {
+            for (int c = r.begin(); c < r.end(); ++c) {
+              const auto& candidate = candidates[c];
+              auto mp = graph_.createMotionPrimitivePtrFromGraph(
+                  start_state, candidate.end_state);
+              mp->compute(graph_.rho());
+              if (mp->cost_ < 0 || !is_mp_collision_free(mp)) continue;
+              Node next_node;
+              next_node.state_index = candidate.index * graph_.num_tiles_;
+              next_node.state = mp->end_state_;
+              next_node.motion_cost = mp->cost_;
+              next_node.heuristic_cost = candidate.heuristic_cost;
+              batch_nodes[c - begin] = std::move(next_node);
+              batch_valid[c - begin] = 1;
+            }
+          });
+      for (int c = 0; c < end - begin; ++c) {
+        if (!batch_valid[c]) continue;
+        valid_count++;
+        history[batch_nodes[c].state] = {start_node,
+                                         batch_nodes[c].motion_cost};
+        nodes.push_back(std::move(batch_nodes[c]));
+      }
+    }
   } else {
     nodes.push_back(start_node);
   }
   if (nodes.size() == 0) ROS_ERROR("Access graph failure");
-  return std::make_pair(nodes, history);
+  return nodes;
 }
 
 Eigen::MatrixXd GraphSearch::shift_polynomial(const Eigen::MatrixXd poly_coeffs,
                                               float shift) {
-  // Pascal's triangle for computing the binomial theorem
-  static Eigen::Matrix<int, 11, 11> combinatorials_ =
-      (Eigen::Matrix<int, 11, 11>() << 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,
-       0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 3, 3, 1, 0,
-       0, 0, 0, 0, 0, 0, 1, 4, 6, 4, 1, 0, 0, 0, 0, 0, 0, 1, 5, 10, 10, 5, 1, 0,
-       0, 0, 0, 0, 1, 6, 15, 20, 15, 6, 1, 0, 0, 0, 0, 1, 7, 21, 35, 35, 21, 7,
-       1, 0, 0, 0, 1, 8, 28, 56, 70, 56, 28, 8, 1, 0, 0, 1, 9, 36, 84, 126, 126,
-       84, 36, 9, 1, 0, 1, 10, 45, 120, 210, 252, 210, 120, 45, 10, 1)
-          .finished();
-
   if (shift == 0) return poly_coeffs;
+  // Shipped coefficient counts run the kernel with compile-time loop
+  // bounds; others take the dynamic fallback.
+  switch (poly_coeffs.cols()) {
+    case 4:
+      return poly_kernels::shift_polynomial<4>(poly_coeffs, shift);
+    case 6:
+      return poly_kernels::shift_polynomial<6>(poly_coeffs, shift);
+    case 8:
+      return poly_kernels::shift_polynomial<8>(poly_coeffs, shift);
+    case 10:
+      return poly_kernels::shift_polynomial<10>(poly_coeffs, shift);
+    default:
+      break;
+  }
+  const auto& combinatorials_ = poly_kernels::combinatorials();
   int n_rows = poly_coeffs.rows();
   int n_cols = poly_coeffs.cols();
   int highest_order = n_cols - 1;
@@ -1,5 +1,6 @@
 // Copyright 2021 Laura Jarin-Lipschitz
 #include <actionlib/server/simple_action_server.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
 #include <kr_planning_msgs/PlanTwoPointAction.h>
 #include <kr_planning_msgs/SplineTrajectory.h>
 #include <kr_planning_msgs/Trajectory.h>
@@ -7,11 +8,21 @@
 #include <motion_primitives/graph_search.h>
 #include <motion_primitives/utils.h>
 #include <ros/ros.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <std_msgs/Float64.h>
 #include <visualization_msgs/MarkerArray.h>
 
+#include <atomic>
 #include <boost/circular_buffer.hpp>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <thread>
+#include <tuple>
 namespace motion_primitives {
 
 template <typename T>
@@ -32,6 +43,7 @@ class PlanningServer {
   ros::Publisher sg_pub_;
   ros::Publisher visited_pub_;
   ros::Publisher time_pub_;
+  ros::Publisher profile_pub_;
   ros::Publisher local_map_cleared_pub_;
   kr_planning_msgs::VoxelMapConstPtr voxel_map_ptr_ = nullptr;
   std::shared_ptr<motion_primitives::MotionPrimitiveGraph> graph_;
@@ -45,6 +57,69 @@ class PlanningServer {
   int graph_index_;
   std::vector<std::string> graph_files_;
   bool parallel_expand_;
+  // Carries search effort (e.g. memoized BVP heuristics) across consecutive
+  // replans; GraphSearch resets it when the goal or graph changes.
+  std::shared_ptr<GraphSearch::SearchContext> search_context_ =
+      std::make_shared<GraphSearch::SearchContext>();
+  // Separate context for the cascade pre-search so the coarse graph never
+  // evicts the fine graph's cached effort (contexts are keyed to one graph).
+  std::shared_ptr<GraphSearch::SearchContext> coarse_context_ =
+      std::make_shared<GraphSearch::SearchContext>();
+  bool cascade_;
+  double cascade_corridor_radius_;
+  double cascade_coarse_budget_;
+  // Footprint regions cleared for the previous query, re-marked dirty when
+  // the footprint moves (see executeCB).
+  std::vector<GraphSearch::SearchContext::DirtyBox> last_footprint_boxes_;
+  // Planning runs on its own worker thread so a slow search never blocks
+  // the actionlib callback thread: an in-flight search is cancelled
+  // immediately when a new goal or a cancel arrives, and voxelMapCB keeps
+  // running.
+  //
+  // Lock ordering: actionlib invokes goalCB/preemptCB while holding the
+  // action server's internal lock, and those callbacks take the mutexes
+  // below — so no thread may call into as_ while holding either of them,
+  // or the spinner and the plan thread deadlock (and with a single
+  // ros::spin() the whole node freezes with them). Goal acceptance and
+  // every terminal-state call happen on the plan thread only, which also
+  // keeps a terminal state from ever landing on a goal another query
+  // produced the result for.
+  std::thread plan_thread_;
+  std::mutex goal_mutex_;  // guards goal_available_, pairs with goal_cv_
+  std::condition_variable goal_cv_;
+  bool goal_available_{false};
+  // Guards cancel_token_ alone and is never held around anything else, so
+  // the actionlib callbacks can flip the token without risking the
+  // ordering above.
+  std::mutex token_mutex_;
+  std::shared_ptr<std::atomic_bool> cancel_token_;
+  std::atomic<bool> shutting_down_{false};
+  std::mutex map_mutex_;
+
+  // --- Map ingestion ---
+  // voxelMapCB only parks the newest message in pending_map_; diff_thread_
+  // diffs it against the previously ingested map, fans a compact change
+  // summary out to the consumers below, and only then publishes the map as
+  // current (voxel_map_ptr_). Searches therefore never see a new map whose
+  // invalidations are not already queued, and the subscriber callback never
+  // pays for the O(map) diff.
+  kr_planning_msgs::VoxelMapConstPtr pending_map_;
+  std::mutex pending_map_mutex_;
+  std::condition_variable map_cv_;
+  std::thread diff_thread_;
+  // Compact description of what changed between consecutive ingested maps:
+  // either the geometry moved (origin/dims/resolution, everything derived
+  // from voxel identity is void) or a set of world-space boxes covering the
+  // changed voxels at 8^3-block granularity.
+  struct MapChangeSummary {
+    bool geometry_changed{false};
+    std::vector<GraphSearch::SearchContext::DirtyBox> dirty_boxes;
+  };
+  // Called on diff_thread_ for each ingested map. The collision caches are
+  // registered in the constructor; incremental ESDF or D*-style features
+  // hook in the same way instead of rescanning the map per replan.
+  std::vector<std::function<void(const MapChangeSummary&)>>
+      map_change_consumers_;
 
  public:
   explicit PlanningServer(const ros::NodeHandle& nh)
@@ -66,9 +141,17 @@ class PlanningServer {
     local_map_cleared_pub_ = pnh_.advertise<kr_planning_msgs::VoxelMap>(
         "local_voxel_map_cleared", 1, true);
     time_pub_ = pnh_.advertise<std_msgs::Float64>("planner_time", 1, true);
+    profile_pub_ = pnh_.advertise<diagnostic_msgs::DiagnosticStatus>(
+        "planner_profile", 1, true);
 
     pnh_.param("planner_timeout", planner_timeout_, 1.0);
     pnh_.param<bool>("parallel_expand", parallel_expand_, true);
+    // Cascade mode: search the coarsest graph first and use its path as a
+    // corridor for the fine search (see executeCB).
+    pnh_.param<bool>("cascade", cascade_, false);
+    pnh_.param("cascade_corridor_radius", cascade_corridor_radius_, 2.0);
+    // Fraction of planner_timeout granted to the coarse pre-search.
+    pnh_.param("cascade_coarse_budget", cascade_coarse_budget_, 0.25);
     ROS_INFO_STREAM("Parallel expand: " << parallel_expand_);
     last_plan_times_ = boost::circular_buffer<double>(10);
     last_plan_failures_ = boost::circular_buffer<bool>(10);
@@ -77,32 +160,147 @@ class PlanningServer {
     pnh_.param("graph_files", graph_files_, std::vector<std::string>());
     pnh_.param("graph_files_dir", graph_files_dir, std::string());
     if (graph_files_.size() > 0) {
-      for (auto filename : graph_files_) {
-        auto full_filename = graph_files_dir + filename + ".json";
-        ROS_INFO_STREAM("Reading graph file " << full_filename);
-        graphs_.push_back(
-            std::make_shared<motion_primitives::MotionPrimitiveGraph>(
-                read_motion_primitive_graph(full_filename)));
-      }
+      // The whole ladder loads concurrently; each file's parse/build is
+      // independent (and itself parallel inside from_json).
+      graphs_.resize(graph_files_.size());
+      tbb::parallel_for(
+          tbb::blocked_range<size_t>(0, graph_files_.size(), 1),
+          [&](const tbb::blocked_range<size_t>& range) {
+            for (size_t k = range.begin(); k < range.end(); ++k) {
+              // Entries with an extension (e.g. ".mpb" for the binary
+              // format) are used as-is, bare names keep the old behavior of
+              // appending ".json".
+              auto full_filename = graph_files_dir + graph_files_[k];
+              if (graph_files_[k].find('.') == std::string::npos)
+                full_filename += ".json";
+              ROS_INFO_STREAM("Reading graph file " << full_filename);
+              auto graph =
+                  std::make_shared<motion_primitives::MotionPrimitiveGraph>(
+                      read_motion_primitive_graph(full_filename));
+              // Sample the edges once at load time so per-query GraphSearch
+              // construction gets the collision-check tables for free.
+              graph->precompute_sample_tables(GraphSearch::Option().step_size);
+              graphs_[k] = std::move(graph);
+            }
+          });
       graph_index_ = static_cast<int>(graph_files_.size() / 2);
       graph_ = graphs_[graph_index_];
       last_graph_ = graph_;
       ROS_INFO_STREAM("Using graph " << graph_files_[graph_index_]);
     }
     ROS_INFO("Finished reading graphs");
-    as_.registerGoalCallback(boost::bind(&PlanningServer::executeCB, this));
+    // The collision caches are the first change-summary consumers; later
+    // incremental features subscribe here instead of diffing themselves.
+    map_change_consumers_.push_back([this](const MapChangeSummary& summary) {
+      if (summary.geometry_changed) {
+        search_context_->DropCollisionCache();
+        coarse_context_->DropCollisionCache();
+      } else if (!summary.dirty_boxes.empty()) {
+        search_context_->MarkDirty(summary.dirty_boxes);
+        coarse_context_->MarkDirty(summary.dirty_boxes);
+      }
+    });
+    as_.registerGoalCallback(boost::bind(&PlanningServer::goalCB, this));
+    as_.registerPreemptCallback(boost::bind(&PlanningServer::preemptCB, this));
+    plan_thread_ = std::thread(&PlanningServer::planLoop, this);
+    diff_thread_ = std::thread(&PlanningServer::mapIngestLoop, this);
     as_.start();
   }
 
-  ~PlanningServer(void) {}
+  ~PlanningServer(void) {
+    shutting_down_.store(true);
+    {
+      std::lock_guard<std::mutex> lock(token_mutex_);
+      if (cancel_token_) cancel_token_->store(true);
+    }
+    {
+      // Pair with the plan thread's wait so the notify cannot be lost.
+      std::lock_guard<std::mutex> lock(goal_mutex_);
+    }
+    goal_cv_.notify_one();
+    {
+      std::lock_guard<std::mutex> lock(pending_map_mutex_);
+    }
+    map_cv_.notify_one();
+    if (plan_thread_.joinable()) plan_thread_.join();
+    if (diff_thread_.joinable()) diff_thread_.join();
+  }
+
+  // Runs on the actionlib callback thread (under the server's internal
+  // lock, see the member comments) and must stay cheap: cancel whatever
+  // search is in flight and wake the worker. The goal itself is accepted
+  // by the plan thread, never here.
+  void goalCB() {
+    {
+      std::lock_guard<std::mutex> lock(token_mutex_);
+      if (cancel_token_) cancel_token_->store(true);
+    }
+    {
+      std::lock_guard<std::mutex> lock(goal_mutex_);
+      goal_available_ = true;
+    }
+    goal_cv_.notify_one();
+  }
+
+  void preemptCB() {
+    std::lock_guard<std::mutex> lock(token_mutex_);
+    if (cancel_token_) cancel_token_->store(true);
+  }
+
+  void planLoop() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(goal_mutex_);
+        goal_cv_.wait(lock, [this] {
+          return shutting_down_ || goal_available_;
+        });
+        if (shutting_down_) return;
+        goal_available_ = false;
+      }
+      // Accept with no lock of ours held. acceptNewGoal marks whatever
+      // goal was active before as preempted, closing it out for us.
+      kr_planning_msgs::PlanTwoPointGoal::ConstPtr goal;
+      if (as_.isNewGoalAvailable()) goal = as_.acceptNewGoal();
+      if (goal == nullptr) continue;
+      auto cancel = std::make_shared<std::atomic_bool>(false);
+      {
+        std::lock_guard<std::mutex> lock(token_mutex_);
+        cancel_token_ = cancel;
+      }
+      executeCB(goal, cancel);
+    }
+  }
+
+  // Rechecked immediately before every terminal action call: once the goal
+  // has been cancelled (client request or a newer goal arriving), the
+  // query's result is stale and must not be published or used to terminate
+  // the action. Returns true when the goal was closed out here. A waiting
+  // newer goal is marked preempted by its own acceptNewGoal on this
+  // thread; only a plain cancel leaves the action for us to finish. Never
+  // called with goal_mutex_/token_mutex_ held (see the lock ordering note
+  // on the members).
+  bool closeOutIfCancelled(const std::shared_ptr<std::atomic_bool>& cancel) {
+    if (!cancel->load()) return false;
+    bool superseded;
+    {
+      std::lock_guard<std::mutex> lock(goal_mutex_);
+      superseded = goal_available_;
+    }
+    if (!superseded && as_.isActive()) as_.setPreempted();
+    return true;
+  }
 
   bool is_outside_map(const Eigen::Vector3i& pn, const Eigen::Vector3i& dim) {
     return pn(0) < 0 || pn(0) >= dim(0) || pn(1) < 0 || pn(1) >= dim(1) ||
            pn(2) < 0 || pn(2) >= dim(2);
   }
 
-  void clear_footprint(kr_planning_msgs::VoxelMap& voxel_map,
-                       const Eigen::Vector3d& point) {
+  // Collects the linear indices of the robot footprint voxels around point
+  // into `cleared`, for GraphSearch to treat as free via its map-view
+  // overlay. The shared map itself is never written (or copied).
+  void clear_footprint(const kr_planning_msgs::VoxelMap& voxel_map,
+                       const Eigen::Vector3d& point,
+                       std::vector<int>* cleared) {
     // TODO(laura) copy-pasted from local_plan_server
     // Clear robot footprint
     // TODO(YUEZHAN): pass robot radius as param
@@ -138,7 +336,7 @@ class PlanningServer {
       Eigen::Vector3i pnn = pn + n;
       int idx_tmp = pnn(0) + pnn(1) * dim(0) + pnn(2) * dim(0) * dim(1);
       if (!is_outside_map(pnn, dim) && voxel_map.data[idx_tmp] != val_free) {
-        voxel_map.data[idx_tmp] = val_free;
+        cleared->push_back(idx_tmp);
       }
     }
   }
@@ -203,15 +401,27 @@ class PlanningServer {
     ROS_INFO_STREAM("Using graph " << graph_files_[graph_index_]);
   }
 
-  void executeCB() {
-    const kr_planning_msgs::PlanTwoPointGoal::ConstPtr& msg =
-        as_.acceptNewGoal();
-    kr_planning_msgs::VoxelMap voxel_map = *voxel_map_ptr_;
-    if (voxel_map.resolution == 0.0) {
+  // Runs on plan_thread_; `cancel` flips to true when a newer goal arrives
+  // or the client cancels.
+  void executeCB(const kr_planning_msgs::PlanTwoPointGoal::ConstPtr& msg,
+                 const std::shared_ptr<std::atomic_bool>& cancel) {
+    kr_planning_msgs::VoxelMapConstPtr map_ptr;
+    {
+      std::lock_guard<std::mutex> lock(map_mutex_);
+      map_ptr = voxel_map_ptr_;
+    }
+    if (map_ptr == nullptr) {
+      ROS_ERROR(
+          "Missing voxel map for motion primitive planner, aborting action "
+          "server.");
+      if (!closeOutIfCancelled(cancel)) as_.setAborted();
+      return;
+    }
+    if (map_ptr->resolution == 0.0) {
       ROS_ERROR(
           "Missing voxel map for motion primitive planner, aborting action "
           "server.");
-      as_.setAborted();
+      if (!closeOutIfCancelled(cancel)) as_.setAborted();
       return;
     }
     std::array<Eigen::VectorXd, 2> start_and_goal = populateStartGoal(msg);
@@ -285,6 +495,14 @@ class PlanningServer {
                                    .start_index = planner_start_index};
     if (graph_->spatial_dim() == 2) options.fixed_z = msg->p_init.position.z;
     if (msg->check_vel) options.velocity_threshold = tol_vel;
+    // Optional goal-directed pruning, off unless configured (it trades
+    // completeness around large obstacles for a smaller open list).
+    pnh_.param("prune_goal_retreat", options.prune_goal_retreat, -1.0);
+    // Let the search enforce the budget itself instead of only judging it
+    // after the fact in adaptivePlanner(); an expired deadline returns the
+    // best (possibly partial) path instead of nothing.
+    options.deadline = planner_timeout_;
+    options.cancel_token = cancel;
     if (planner_start_index == -1 ||
         planner_start_index >= graph_->num_tiled_states())
       options.access_graph = true;
@@ -292,13 +510,31 @@ class PlanningServer {
     // ever happen except when switching graphs, but checking if
     // graph_index_!=last_graph.graph_index didn't work
 
-    publishStartAndGoal(start_and_goal, options.fixed_z);
+    publishStartAndGoal(start_and_goal, options.fixed_z, map_ptr->header);
+    // The search reads the subscriber's map in place; footprint clearing
+    // goes into the view's overlay instead of a mutable map copy.
+    GraphSearch::VoxelMapView map_view;
+    map_view.map = map_ptr;
     Eigen::Vector3d map_start;
     map_start(0) = start(0);
     map_start(1) = start(1);
     map_start(2) = msg->p_init.position.z;
     // Sets the voxel_map_ start to be collision free
-    clear_footprint(voxel_map, map_start);
+    clear_footprint(*map_ptr, map_start, &map_view.cleared);
+
+    // Cached collision verdicts are computed against the footprint-cleared
+    // view, so they go stale whenever the footprint moves: the previous
+    // footprint's voxels revert to the raw map, the current one's flip to
+    // free. Mark both regions dirty before any search adopts the context.
+    std::vector<GraphSearch::SearchContext::DirtyBox> footprint_boxes;
+    // Radius matches robot_r in clear_footprint, padded a couple voxels.
+    const float footprint_pad = 0.5 + 2 * map_ptr->resolution;
+    const auto add_footprint_box = [&](const Eigen::Vector3d& point) {
+      footprint_boxes.emplace_back(
+          point.cast<float>() - Eigen::Vector3f::Constant(footprint_pad),
+          point.cast<float>() + Eigen::Vector3f::Constant(footprint_pad));
+    };
+    add_footprint_box(map_start);
 
     // If we are not at the end, we can also clear the local goal
     if (!msg->check_vel) {
@@ -306,14 +542,90 @@ class PlanningServer {
       map_goal(0) = goal(0);
       map_goal(1) = goal(1);
       map_goal(2) = msg->p_init.position.z;
-      clear_footprint(voxel_map, map_goal);
-      // local_map_cleared_pub_.publish(voxel_map);
+      clear_footprint(*map_ptr, map_goal, &map_view.cleared);
+      add_footprint_box(map_goal);
+    }
+
+    {
+      auto dirty = footprint_boxes;
+      dirty.insert(dirty.end(), last_footprint_boxes_.begin(),
+                   last_footprint_boxes_.end());
+      search_context_->MarkDirty(dirty);
+      coarse_context_->MarkDirty(dirty);
+      last_footprint_boxes_ = std::move(footprint_boxes);
     }
 
-    GraphSearch gs(*graph_, voxel_map, options);
     const auto start_time = ros::Time::now();
 
-    auto [path, nodes] = gs.Search();
+    // Cascade: spend a small slice of the budget on the coarsest graph
+    // first. Its path (cheap, low-resolution) becomes a corridor that
+    // focuses the fine search, which today occasionally burns the whole
+    // budget exploring and aborts. Falls through unfocused if the coarse
+    // search finds nothing.
+    if (cascade_ && graphs_.size() > 1 && graph_index_ > 0) {
+      GraphSearch::Option coarse_options = options;
+      // planner_start_index indexes graph_, not the coarse graph.
+      coarse_options.start_index = 0;
+      coarse_options.access_graph = true;
+      coarse_options.deadline = planner_timeout_ * cascade_coarse_budget_;
+      const auto& coarse_graph = graphs_.front();
+      GraphSearch coarse_gs(*coarse_graph, map_view, coarse_options,
+                            coarse_context_);
+      const auto coarse_path = coarse_gs.Search().first;
+      if (!coarse_path.empty()) {
+        // The tube must cover the coarse graph's own discretization error
+        // or the fine path gets pruned out of its corridor.
+        const double radius =
+            std::max(cascade_corridor_radius_, coarse_graph->dispersion());
+        // sample_positions takes a time step; convert the desired spatial
+        // spacing (half the radius, so consecutive samples overlap and the
+        // tube stays connected) through the graph's per-axis velocity
+        // bound, under which samples dt apart are at most
+        // vmax * sqrt(dim) * dt from each other.
+        const double sample_dt =
+            0.5 * radius /
+            (coarse_graph->max_state()(1) *
+             std::sqrt(coarse_graph->spatial_dim()));
+        std::vector<Eigen::MatrixXd> segments;
+        int num_cols = 0;
+        for (const auto& mp : coarse_path) {
+          segments.push_back(mp->sample_positions(sample_dt));
+          num_cols += segments.back().cols();
+        }
+        options.corridor.resize(graph_->spatial_dim(), num_cols);
+        int col = 0;
+        for (const auto& segment : segments) {
+          options.corridor.middleCols(col, segment.cols()) = segment;
+          col += segment.cols();
+        }
+        options.corridor_radius = radius;
+      } else {
+        ROS_WARN("Cascade coarse search found no path, searching unfocused");
+      }
+      options.deadline = std::max(
+          planner_timeout_ - (ros::Time::now() - start_time).toSec(), 0.05);
+    }
+
+    auto gs = std::make_unique<GraphSearch>(*graph_, map_view, options,
+                                            search_context_);
+    auto [path, nodes] = gs->Search();
+    if (path.empty() && options.corridor.cols() > 0 && !cancel->load()) {
+      // The tube can exclude every fine-graph path (the two graphs'
+      // dynamics differ), so retry unfocused on the remaining budget
+      // rather than aborting a solvable query.
+      ROS_WARN("Cascade-focused search failed, retrying without corridor");
+      options.corridor.resize(0, 0);
+      options.corridor_radius = 0;
+      options.deadline = std::max(
+          planner_timeout_ - (ros::Time::now() - start_time).toSec(), 0.05);
+      gs = std::make_unique<GraphSearch>(*graph_, map_view, options,
+                                         search_context_);
+      std::tie(path, nodes) = gs->Search();
+    }
+    if (closeOutIfCancelled(cancel)) {
+      ROS_WARN("Planning cancelled mid-search");
+      return;
+    }
     int last_graph_index = graph_index_;
     adaptivePlanner();
     bool planner_start_too_close_to_goal =
@@ -323,7 +635,7 @@ class PlanningServer {
       if (!planner_start_too_close_to_goal) {
         ROS_ERROR("Graph search failed, aborting action server.");
         last_plan_failures_.push_back(true);
-        as_.setAborted();
+        if (!closeOutIfCancelled(cancel)) as_.setAborted();
         return;
       }
     }
@@ -376,6 +688,15 @@ class PlanningServer {
       path.insert(path.begin(), first_mp);
     }
 
+    // The post-search tail above (adaptivePlanner, first-mp cropping with
+    // its trajectory optimization) is long enough for a preempting goal or
+    // cancel to land; recheck so a superseded query never publishes its
+    // trajectory or terminates the goal that replaced it.
+    if (closeOutIfCancelled(cancel)) {
+      ROS_WARN("Goal cancelled before the result was ready");
+      return;
+    }
+
     ROS_INFO("Graph search succeeded.");
     last_plan_failures_.push_back(false);
 
@@ -386,12 +707,25 @@ class PlanningServer {
     time.data = total_time;
     time_pub_.publish(time);
 
+    // Where the planning time went, per phase and counter (see profiler.h),
+    // so field failures can be diagnosed from the bag instead of rerun.
+    diagnostic_msgs::DiagnosticStatus profile_msg;
+    profile_msg.name = "motion_primitives/graph_search";
+    profile_msg.level = diagnostic_msgs::DiagnosticStatus::OK;
+    for (const auto& [key, value] : gs->profiler().report()) {
+      diagnostic_msgs::KeyValue kv;
+      kv.key = key;
+      kv.value = std::to_string(value);
+      profile_msg.values.push_back(kv);
+    }
+    profile_pub_.publish(profile_msg);
+
     kr_planning_msgs::PlanTwoPointResult result;
     result.epoch = msg->epoch;
     result.execution_time = msg->execution_time;
     result.traj = kr_planning_msgs::SplineTrajectory();
     result.traj.header.stamp = ros::Time::now();
-    result.traj.header.frame_id = voxel_map.header.frame_id;
+    result.traj.header.frame_id = map_ptr->header.frame_id;
     result.success = true;
     result.traj = path_to_spline_traj_msg(path, result.traj.header,
                                           msg->p_init.position.z);
@@ -406,13 +740,110 @@ class PlanningServer {
 
     ROS_INFO_STREAM("path size: " << path.size());
 
-    const auto visited_marray = StatesToMarkerArray(
-        gs.GetVisitedStates(), gs.spatial_dim(), voxel_map.header);
-    visited_pub_.publish(visited_marray);
+    // Debug visualization only; building a marker per visited state is
+    // expensive, so skip it entirely unless someone (e.g. rviz) is
+    // listening. Runs after setSucceeded so it never delays the result.
+    if (visited_pub_.getNumSubscribers() > 0) {
+      const auto visited_marray = StatesToMarkerArray(
+          gs->GetVisitedStates(), gs->spatial_dim(), map_ptr->header);
+      visited_pub_.publish(visited_marray);
+    }
   }
 
+  // Stays cheap: just parks the newest message for the diff thread. A map
+  // arriving before the previous one was diffed simply replaces it.
   void voxelMapCB(const kr_planning_msgs::VoxelMap::ConstPtr& msg) {
-    voxel_map_ptr_ = msg;
+    {
+      std::lock_guard<std::mutex> lock(pending_map_mutex_);
+      pending_map_ = msg;
+    }
+    map_cv_.notify_one();
+  }
+
+  // Runs on diff_thread_ (see the member comments): summary first, map
+  // swap second, so by the time a search can copy the new pointer the
+  // consumers already queued their invalidations.
+  void mapIngestLoop() {
+    kr_planning_msgs::VoxelMapConstPtr prev;
+    while (true) {
+      kr_planning_msgs::VoxelMapConstPtr next;
+      {
+        std::unique_lock<std::mutex> lock(pending_map_mutex_);
+        map_cv_.wait(lock, [this] {
+          return shutting_down_ || pending_map_ != nullptr;
+        });
+        if (shutting_down_) return;
+        next = std::move(pending_map_);
+        pending_map_ = nullptr;
+      }
+      const MapChangeSummary summary = computeChangeSummary(prev, next);
+      for (const auto& consumer : map_change_consumers_) consumer(summary);
+      {
+        // plan_thread_ reads the pointer concurrently.
+        std::lock_guard<std::mutex> lock(map_mutex_);
+        voxel_map_ptr_ = next;
+      }
+      prev = std::move(next);
+    }
+  }
+
+  // Turns the difference between consecutive maps into a compact change
+  // summary. With identical geometry the changed voxels are covered by
+  // dirty 8^3-voxel blocks, which in steady-state flight cluster at the
+  // sensor frontier; a moved origin or a resize re-bins everything, so the
+  // summary just flags the geometry change.
+  MapChangeSummary computeChangeSummary(
+      const kr_planning_msgs::VoxelMapConstPtr& prev,
+      const kr_planning_msgs::VoxelMapConstPtr& msg) {
+    MapChangeSummary summary;
+    if (prev == nullptr) return summary;
+    const bool same_geometry =
+        prev->resolution == msg->resolution &&
+        prev->origin.x == msg->origin.x && prev->origin.y == msg->origin.y &&
+        prev->origin.z == msg->origin.z && prev->dim.x == msg->dim.x &&
+        prev->dim.y == msg->dim.y && prev->dim.z == msg->dim.z &&
+        prev->data.size() == msg->data.size();
+    if (!same_geometry) {
+      summary.geometry_changed = true;
+      return summary;
+    }
+    constexpr int kBlock = 8;
+    const int nx = std::max(static_cast<int>(msg->dim.x), 1);
+    const int ny = std::max(static_cast<int>(msg->dim.y), 1);
+    const int nz = std::max(static_cast<int>(msg->dim.z), 1);
+    const int bx = (nx + kBlock - 1) / kBlock;
+    const int by = (ny + kBlock - 1) / kBlock;
+    const int bz = (nz + kBlock - 1) / kBlock;
+    std::vector<char> dirty(static_cast<size_t>(bx) * by * bz, 0);
+    bool any_dirty = false;
+    size_t idx = 0;
+    for (int z = 0; z < nz; z++) {
+      for (int y = 0; y < ny; y++) {
+        for (int x = 0; x < nx; x++, idx++) {
+          if (prev->data[idx] != msg->data[idx]) {
+            dirty[(x / kBlock) + bx * (y / kBlock) +
+                  bx * by * (z / kBlock)] = 1;
+            any_dirty = true;
+          }
+        }
+      }
+    }
+    if (!any_dirty) return summary;
+    auto& boxes = summary.dirty_boxes;
+    const double res = msg->resolution;
+    for (int z = 0; z < bz; z++) {
+      for (int y = 0; y < by; y++) {
+        for (int x = 0; x < bx; x++) {
+          if (!dirty[x + bx * y + bx * by * z]) continue;
+          const Eigen::Vector3f lo(msg->origin.x + x * kBlock * res,
+                                   msg->origin.y + y * kBlock * res,
+                                   msg->origin.z + z * kBlock * res);
+          boxes.emplace_back(
+              lo, lo + Eigen::Vector3f::Constant(kBlock * res));
+        }
+      }
+    }
+    return summary;
   }
 
   std::array<double, 3> pointMsgToArray(const geometry_msgs::Point& point) {
@@ -451,10 +882,10 @@ class PlanningServer {
   }
 
   void publishStartAndGoal(const std::array<Eigen::VectorXd, 2>& start_and_goal,
-                           double fixed_z) {
+                           double fixed_z, const std_msgs::Header& map_header) {
     visualization_msgs::MarkerArray sg_markers;
     visualization_msgs::Marker start_marker, goal_marker;
-    start_marker.header = voxel_map_ptr_->header;
+    start_marker.header = map_header;
     start_marker.pose.position.x = start_and_goal[0][0],
     start_marker.pose.position.y = start_and_goal[0][1];
     start_marker.pose.orientation.w = 1;
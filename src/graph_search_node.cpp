@@ -94,8 +94,8 @@ int main(int argc, char** argv) {
 
     ROS_INFO("Finished planning. Planning time %f s", total_time);
     ROS_INFO_STREAM("path size: " << path.size());
-    for (const auto& [k, v] : gs.timings()) {
-      ROS_INFO_STREAM(k << ": " << v << "s, " << (v / total_time * 100) << "%");
+    for (const auto& [k, v] : gs.profiler().report()) {
+      ROS_INFO_STREAM(k << ": " << v);
     }
     const auto visited_marray = StatesToMarkerArray(
         gs.GetVisitedStates(), gs.spatial_dim(), voxel_map.header,.4);
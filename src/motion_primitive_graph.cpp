@@ -5,11 +5,22 @@
 #include <kr_planning_msgs/Polynomial.h>
 #include <mav_trajectory_generation/polynomial_optimization_nonlinear.h>
 #include <ros/console.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
 #include <fstream>
+#include <limits>
 #include <nlohmann/json.hpp>
 #include <ostream>
 
+#include "motion_primitives/polynomial_kernels.h"
+
 using kr_planning_msgs::Polynomial;
 using kr_planning_msgs::Spline;
 namespace motion_primitives {
@@ -33,7 +44,15 @@ void MotionPrimitive::translate_using_end(const Eigen::VectorXd& new_end) {
 
 void RuckigMotionPrimitive::translate(const Eigen::VectorXd& new_start) {
   MotionPrimitive::translate(new_start);
-  compute();
+  if (!profile_valid_) {
+    // First translation of a graph-stored primitive triggers the deferred
+    // profile synthesis; afterwards translation is just an offset update.
+    compute();
+    return;
+  }
+  for (int dim = 0; dim < spatial_dim_; dim++) {
+    position_offset_[dim] = start_state_(dim) - profile_start_[dim];
+  }
 }
 
 Spline MotionPrimitive::add_to_spline(Spline spline, int dim) {
@@ -95,12 +114,46 @@ Eigen::MatrixXd MotionPrimitive::sample_positions(double step_size) const {
   Eigen::VectorXd times =
       Eigen::VectorXd::LinSpaced(num_samples, 0, traj_time_);
 
-  Eigen::MatrixXd result(spatial_dim_, num_samples);
+  return evaluate_positions(times);
+}
 
+Eigen::MatrixXd MotionPrimitive::evaluate_positions(
+    const Eigen::VectorXd& times) const {
+  // Coefficient counts we ship get the fixed-size kernel; anything else
+  // takes the dynamic fallback below.
+  const int num_coeffs = poly_coeffs_.cols();
+  switch (num_coeffs) {
+    case 4:
+      return poly_kernels::evaluate_positions<4>(poly_coeffs_, times);
+    case 6:
+      return poly_kernels::evaluate_positions<6>(poly_coeffs_, times);
+    case 8:
+      return poly_kernels::evaluate_positions<8>(poly_coeffs_, times);
+    case 10:
+      return poly_kernels::evaluate_positions<10>(poly_coeffs_, times);
+    default:
+      break;
+  }
+  // Row k of the power matrix holds t^(cols - 1 - k), matching the
+  // highest-power-first layout of poly_coeffs_. Built from the previous row
+  // by an elementwise product, so there are no pow() calls, and the single
+  // matrix product below evaluates every sample at once.
+  Eigen::MatrixXd powers(num_coeffs, times.size());
+  powers.row(num_coeffs - 1).setOnes();
+  for (int k = num_coeffs - 2; k >= 0; --k) {
+    powers.row(k) = powers.row(k + 1).cwiseProduct(times.transpose());
+  }
+  return poly_coeffs_ * powers;
+}
+
+Eigen::MatrixXd RuckigMotionPrimitive::evaluate_positions(
+    const Eigen::VectorXd& times) const {
+  // Positions come from ruckig's per-time profile lookup, so there is no
+  // batched closed form to exploit here.
+  Eigen::MatrixXd result(spatial_dim_, times.size());
   for (int i = 0; i < times.size(); ++i) {
     result.col(i) = evaluate_primitive(times(i));
   }
-
   return result;
 }
 
@@ -242,12 +295,18 @@ void RuckigMotionPrimitive::compute() {
   if (result < 0) {
     traj_time_ = -1;
     cost_ = -1;
+    profile_valid_ = false;
     ROS_ERROR("Ruckig error %d",
               result);  // TODO(laura) should do more than print
   } else {
     traj_time_ = ruckig_traj_.duration;
 
     cost_ = traj_time_;
+    profile_valid_ = true;
+    position_offset_.setZero();
+    for (int dim = 0; dim < spatial_dim_; dim++) {
+      profile_start_[dim] = start_state_(dim);
+    }
   }
 }
 
@@ -257,13 +316,54 @@ Eigen::VectorXd RuckigMotionPrimitive::evaluate_primitive(float t) const {
   // Eigen::VectorXd state(3 * spatial_dim_);
   Eigen::VectorXd state(spatial_dim_);
   for (int dim = 0; dim < spatial_dim_; dim++) {
-    state[dim] = position[dim];
+    // The stored profile is relative to profile_start_, see translate().
+    state[dim] = position[dim] + position_offset_[dim];
     // state[spatial_dim_ + dim] = velocity[dim];
     // state[2 * spatial_dim_ + dim] = acceleration[dim];
   }
   return state;
 }
 
+void MotionPrimitiveGraph::build_successor_lists() {
+  const int num_vertices = edges_.cols();
+  successor_offsets_.assign(num_vertices + 1, 0);
+  for (int j = 0; j < num_vertices; j++) {
+    for (int i = 0; i < edges_.rows(); i++) {
+      if (edges_(i, j) >= 0) successor_offsets_[j + 1]++;
+    }
+  }
+  for (int j = 0; j < num_vertices; j++) {
+    successor_offsets_[j + 1] += successor_offsets_[j];
+  }
+  successors_.resize(successor_offsets_[num_vertices]);
+  std::vector<int> next_slot(successor_offsets_.begin(),
+                             successor_offsets_.end() - 1);
+  for (int j = 0; j < num_vertices; j++) {
+    for (int i = 0; i < edges_.rows(); i++) {
+      if (edges_(i, j) >= 0) {
+        successors_[next_slot[j]++] = Successor{i, edges_(i, j)};
+      }
+    }
+  }
+}
+
+void MotionPrimitiveGraph::precompute_sample_tables(double step_size) {
+  if (has_sample_tables(step_size)) return;
+  mp_sample_tables_.resize(mps_.size());
+  for (size_t i = 0; i < mps_.size(); i++) {
+    // Sample a clone, never the stored primitive: mps_ is shared (by
+    // shared_ptr) with the caller's graph and every other copy of it, so
+    // mutating here races with concurrent GraphSearch constructions over
+    // one graph (e.g. the python batch_search). The clone's
+    // self-translation is a no-op for polynomial primitives and triggers
+    // the profile synthesis RuckigMotionPrimitive defers until translate().
+    auto mp = mps_[i]->clone();
+    mp->translate(mp->start_state_);
+    mp_sample_tables_[i] = mp->sample_positions(step_size);
+  }
+  sample_table_step_size_ = step_size;
+}
+
 std::ostream& operator<<(std::ostream& os, const MotionPrimitive& m) {
   os << "start state: " << m.start_state_.transpose() << "\n";
   os << "end state: " << m.end_state_.transpose() << "\n";
@@ -319,42 +419,299 @@ void from_json(const nlohmann::json& json_data, MotionPrimitiveGraph& graph) {
   }
   graph.edges_.resize(graph.vertices_.rows() * graph.num_tiles_,
                       graph.vertices_.rows());
-  for (int i = 0; i < graph.vertices_.rows() * graph.num_tiles_; i++) {
-    for (int j = 0; j < graph.vertices_.rows(); j++) {
-      auto edge = json_data.at("edges").at(i * graph.vertices_.rows() + j);
-      if (edge.size() > 0) {
-        auto s = edge.at("start_state").get<std::vector<double>>();
-        Eigen::Map<Eigen::VectorXd> start_state(s.data(), s.size());
-        auto e = edge.at("end_state").get<std::vector<double>>();
-        Eigen::Map<Eigen::VectorXd> end_state(e.data(), e.size());
-
-        Eigen::MatrixXd poly_coeffs;
-        if (edge.contains("polys")) {
-          poly_coeffs.resize(graph.spatial_dim_, edge.at("polys")[0].size());
-          for (int k = 0; k < graph.spatial_dim_; k++) {
-            auto x = edge.at("polys")[k].get<std::vector<double>>();
-            poly_coeffs.row(k) =
-                Eigen::Map<Eigen::VectorXd>(x.data(), x.size());
-          }
-        }
-        auto mp = MotionPrimitiveGraph::createMotionPrimitivePtrFromTypeName(
-            graph.mp_type_name_, graph.spatial_dim_, start_state, end_state,
-            graph.max_state_);
-        mp->populate(edge.at("cost"), edge.at("traj_time"), poly_coeffs, j, i);
-        graph.edges_(i, j) = graph.mps_.size();
-        graph.mps_.push_back(mp);
-      } else {
-        graph.edges_(i, j) = -1;  // TODO(laura) make constant
-      }
+  const auto& edges_json = json_data.at("edges");
+  const int num_rows = graph.vertices_.rows() * graph.num_tiles_;
+  const int num_cols = graph.vertices_.rows();
+  // Pass 1 (serial, cheap): assign every populated slot its index into
+  // mps_, so pass 2 can materialize the primitives in any order into
+  // pre-sized storage instead of a serial push_back.
+  int num_mps = 0;
+  for (int i = 0; i < num_rows; i++) {
+    for (int j = 0; j < num_cols; j++) {
+      const auto& edge = edges_json.at(i * num_cols + j);
+      graph.edges_(i, j) =
+          edge.size() > 0 ? num_mps++ : -1;  // TODO(laura) make constant
     }
   }
+  graph.mps_.resize(num_mps);
+  // Pass 2: the expensive part (state parsing, poly matrix fills, primitive
+  // allocation) across all cores. Concurrent const reads of the json tree
+  // are safe and every worker writes only its own mps_ slots.
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, num_rows * num_cols),
+      [&](const tbb::blocked_range<int>& range) {
+        for (int slot = range.begin(); slot < range.end(); ++slot) {
+          const int i = slot / num_cols;
+          const int j = slot % num_cols;
+          const int mp_index = graph.edges_(i, j);
+          if (mp_index < 0) continue;
+          const auto& edge = edges_json.at(slot);
+          auto s = edge.at("start_state").get<std::vector<double>>();
+          Eigen::Map<Eigen::VectorXd> start_state(s.data(), s.size());
+          auto e = edge.at("end_state").get<std::vector<double>>();
+          Eigen::Map<Eigen::VectorXd> end_state(e.data(), e.size());
+
+          Eigen::MatrixXd poly_coeffs;
+          if (edge.contains("polys")) {
+            poly_coeffs.resize(graph.spatial_dim_, edge.at("polys")[0].size());
+            for (int k = 0; k < graph.spatial_dim_; k++) {
+              auto x = edge.at("polys")[k].get<std::vector<double>>();
+              poly_coeffs.row(k) =
+                  Eigen::Map<Eigen::VectorXd>(x.data(), x.size());
+            }
+          }
+          auto mp = MotionPrimitiveGraph::createMotionPrimitivePtrFromTypeName(
+              graph.mp_type_name_, graph.spatial_dim_, start_state, end_state,
+              graph.max_state_);
+          mp->populate(edge.at("cost"), edge.at("traj_time"), poly_coeffs, j,
+                       i);
+          graph.mps_[mp_index] = mp;
+        }
+      });
+  graph.build_successor_lists();
 }
 
 MotionPrimitiveGraph read_motion_primitive_graph(const std::string& s) {
+  const std::string binary_suffix = ".mpb";
+  if (s.size() > binary_suffix.size() &&
+      s.compare(s.size() - binary_suffix.size(), binary_suffix.size(),
+                binary_suffix) == 0) {
+    return read_motion_primitive_graph_binary(s);
+  }
   std::ifstream json_file(s);
   nlohmann::json json_data;
   json_file >> json_data;
   return json_data.get<motion_primitives::MotionPrimitiveGraph>();
 }
 
+namespace {
+// Helpers for the binary graph format. Everything is written as flat
+// little-endian arrays; memcpy is used on the read side so the mapped file
+// does not need to be aligned.
+constexpr uint32_t kBinaryGraphMagic = 0x4D504742;  // "MPGB"
+constexpr uint32_t kBinaryGraphVersion = 1;
+
+template <typename T>
+void write_scalar(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void write_doubles(std::ofstream& out, const double* data, uint64_t count) {
+  write_scalar(out, count);
+  out.write(reinterpret_cast<const char*>(data), count * sizeof(double));
+}
+
+// Bounds-checked cursor over the mapped file. A truncated or corrupt .mpb
+// (or one advertising oversized counts) must not walk off the mapping and
+// SIGBUS the planner at startup, so every read is validated against the
+// mapped length and any overrun leaves the reader sticky-bad.
+class BinaryReader {
+ public:
+  BinaryReader(const char* data, size_t size) : ptr_(data), end_(data + size) {}
+
+  template <typename T>
+  T read_scalar() {
+    T value{};
+    read_bytes(&value, sizeof(T));
+    return value;
+  }
+
+  bool read_bytes(void* dst, size_t count) {
+    const char* src = take(count);
+    if (src == nullptr) return false;
+    std::memcpy(dst, src, count);
+    return true;
+  }
+
+  // Pointer to the next count bytes (advancing past them), nullptr on
+  // overrun.
+  const char* take(size_t count) {
+    if (!has_bytes(count)) {
+      ok_ = false;
+      return nullptr;
+    }
+    const char* p = ptr_;
+    ptr_ += count;
+    return p;
+  }
+
+  // Whether count elements of elem_size bytes fit in what is left; the
+  // division sidesteps overflow from hostile counts.
+  bool has_array(uint64_t count, size_t elem_size) const {
+    return ok_ && count <= remaining() / elem_size;
+  }
+  bool has_bytes(size_t count) const { return ok_ && count <= remaining(); }
+  bool ok() const { return ok_; }
+  void invalidate() { ok_ = false; }
+
+ private:
+  size_t remaining() const { return static_cast<size_t>(end_ - ptr_); }
+  const char* ptr_;
+  const char* end_;
+  bool ok_{true};
+};
+
+Eigen::VectorXd read_vector(BinaryReader& in) {
+  const auto count = in.read_scalar<uint64_t>();
+  if (!in.has_array(count, sizeof(double))) {
+    in.invalidate();
+    return Eigen::VectorXd();
+  }
+  Eigen::VectorXd v(count);
+  in.read_bytes(v.data(), count * sizeof(double));
+  return v;
+}
+
+// Whether a rows x cols array of elem_size-byte elements fits in what the
+// reader has left, guarding the product against overflow.
+bool fits_matrix(const BinaryReader& in, uint64_t rows, uint64_t cols,
+                 size_t elem_size) {
+  if (rows != 0 && cols > std::numeric_limits<uint64_t>::max() / rows)
+    return false;
+  return in.has_array(rows * cols, elem_size);
+}
+}  // namespace
+
+void write_motion_primitive_graph_binary(const MotionPrimitiveGraph& graph,
+                                         const std::string& s) {
+  std::ofstream out(s, std::ios::binary);
+  write_scalar(out, kBinaryGraphMagic);
+  write_scalar(out, kBinaryGraphVersion);
+  write_scalar(out, static_cast<int32_t>(graph.spatial_dim_));
+  write_scalar(out, static_cast<int32_t>(graph.control_space_dim_));
+  write_scalar(out, static_cast<int32_t>(graph.state_dim_));
+  write_scalar(out, static_cast<int32_t>(graph.num_tiles_));
+  write_scalar(out, static_cast<int32_t>(graph.tiling_));
+  write_scalar(out, graph.dispersion_);
+  write_scalar(out, graph.rho_);
+  write_scalar(out, static_cast<uint64_t>(graph.mp_type_name_.size()));
+  out.write(graph.mp_type_name_.data(), graph.mp_type_name_.size());
+  write_doubles(out, graph.max_state_.data(), graph.max_state_.size());
+  write_scalar(out, static_cast<uint64_t>(graph.vertices_.rows()));
+  write_scalar(out, static_cast<uint64_t>(graph.vertices_.cols()));
+  out.write(reinterpret_cast<const char*>(graph.vertices_.data()),
+            graph.vertices_.size() * sizeof(double));
+  write_scalar(out, static_cast<uint64_t>(graph.edges_.rows()));
+  write_scalar(out, static_cast<uint64_t>(graph.edges_.cols()));
+  out.write(reinterpret_cast<const char*>(graph.edges_.data()),
+            graph.edges_.size() * sizeof(int));
+  write_scalar(out, static_cast<uint64_t>(graph.mps_.size()));
+  for (const auto& mp : graph.mps_) {
+    write_doubles(out, mp->start_state_.data(), mp->start_state_.size());
+    write_doubles(out, mp->end_state_.data(), mp->end_state_.size());
+    write_scalar(out, mp->cost_);
+    write_scalar(out, mp->traj_time_);
+    write_scalar(out, static_cast<int32_t>(mp->start_index_));
+    write_scalar(out, static_cast<int32_t>(mp->end_index_));
+    write_scalar(out, static_cast<uint64_t>(mp->poly_coeffs_.rows()));
+    write_scalar(out, static_cast<uint64_t>(mp->poly_coeffs_.cols()));
+    out.write(reinterpret_cast<const char*>(mp->poly_coeffs_.data()),
+              mp->poly_coeffs_.size() * sizeof(double));
+  }
+}
+
+MotionPrimitiveGraph read_motion_primitive_graph_binary(const std::string& s) {
+  MotionPrimitiveGraph graph;
+  const int fd = open(s.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ROS_ERROR("Failed to open binary graph file %s", s.c_str());
+    return graph;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    ROS_ERROR("Failed to stat binary graph file %s", s.c_str());
+    close(fd);
+    return graph;
+  }
+  const auto file_size = static_cast<size_t>(file_stat.st_size);
+  const char* mapped = static_cast<const char*>(
+      mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0));
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    ROS_ERROR("Failed to mmap binary graph file %s", s.c_str());
+    return graph;
+  }
+
+  // Every read goes through the bounds-checked cursor; on any overrun bail
+  // with the existing empty-graph pattern instead of touching memory past
+  // the mapping. Counts are validated before the resizes they drive so an
+  // oversized header field cannot trigger a huge allocation either.
+  BinaryReader reader(mapped, file_size);
+  const auto fail = [&]() {
+    ROS_ERROR("Truncated or corrupt binary graph file %s", s.c_str());
+    munmap(const_cast<char*>(mapped), file_size);
+    return MotionPrimitiveGraph();
+  };
+  const auto magic = reader.read_scalar<uint32_t>();
+  const auto version = reader.read_scalar<uint32_t>();
+  if (!reader.ok()) return fail();
+  if (magic != kBinaryGraphMagic || version != kBinaryGraphVersion) {
+    ROS_ERROR("Bad magic/version in binary graph file %s", s.c_str());
+    munmap(const_cast<char*>(mapped), file_size);
+    return graph;
+  }
+  graph.spatial_dim_ = reader.read_scalar<int32_t>();
+  graph.control_space_dim_ = reader.read_scalar<int32_t>();
+  graph.state_dim_ = reader.read_scalar<int32_t>();
+  graph.num_tiles_ = reader.read_scalar<int32_t>();
+  graph.tiling_ = reader.read_scalar<int32_t>();
+  graph.dispersion_ = reader.read_scalar<double>();
+  graph.rho_ = reader.read_scalar<double>();
+  const auto name_size = reader.read_scalar<uint64_t>();
+  const char* name = reader.take(name_size);
+  if (name == nullptr) return fail();
+  graph.mp_type_name_.assign(name, name_size);
+  // The factory throws on unknown type names; reject a garbage name here
+  // with the same error path as every other corruption.
+  if (graph.mp_type_name_ != "RuckigMotionPrimitive" &&
+      graph.mp_type_name_ != "PolynomialMotionPrimitive" &&
+      graph.mp_type_name_ != "OptimizationMotionPrimitive" &&
+      graph.mp_type_name_ != "ETHMotionPrimitive")
+    return fail();
+  graph.max_state_ = read_vector(reader);
+  const auto vertex_rows = reader.read_scalar<uint64_t>();
+  const auto vertex_cols = reader.read_scalar<uint64_t>();
+  if (!fits_matrix(reader, vertex_rows, vertex_cols, sizeof(double)))
+    return fail();
+  graph.vertices_.resize(vertex_rows, vertex_cols);
+  reader.read_bytes(graph.vertices_.data(),
+                    graph.vertices_.size() * sizeof(double));
+  const auto edge_rows = reader.read_scalar<uint64_t>();
+  const auto edge_cols = reader.read_scalar<uint64_t>();
+  if (!fits_matrix(reader, edge_rows, edge_cols, sizeof(int))) return fail();
+  graph.edges_.resize(edge_rows, edge_cols);
+  reader.read_bytes(graph.edges_.data(), graph.edges_.size() * sizeof(int));
+  const auto num_mps = reader.read_scalar<uint64_t>();
+  // Each serialized primitive holds at least its seven 8-byte size/scalar
+  // fields, so an oversized count cannot pass this (and cannot blow up the
+  // reserve below).
+  if (!reader.has_array(num_mps, 7 * sizeof(uint64_t))) return fail();
+  graph.mps_.reserve(num_mps);
+  for (uint64_t i = 0; i < num_mps; i++) {
+    const Eigen::VectorXd start_state = read_vector(reader);
+    const Eigen::VectorXd end_state = read_vector(reader);
+    const auto cost = reader.read_scalar<double>();
+    const auto traj_time = reader.read_scalar<double>();
+    const auto start_index = reader.read_scalar<int32_t>();
+    const auto end_index = reader.read_scalar<int32_t>();
+    const auto poly_rows = reader.read_scalar<uint64_t>();
+    const auto poly_cols = reader.read_scalar<uint64_t>();
+    if (!fits_matrix(reader, poly_rows, poly_cols, sizeof(double)))
+      return fail();
+    Eigen::MatrixXd poly_coeffs(poly_rows, poly_cols);
+    reader.read_bytes(poly_coeffs.data(),
+                      poly_coeffs.size() * sizeof(double));
+    if (!reader.ok()) return fail();
+    auto mp = MotionPrimitiveGraph::createMotionPrimitivePtrFromTypeName(
+        graph.mp_type_name_, graph.spatial_dim_, start_state, end_state,
+        graph.max_state_);
+    mp->populate(cost, traj_time, poly_coeffs, start_index, end_index);
+    graph.mps_.push_back(mp);
+  }
+  if (!reader.ok()) return fail();
+  munmap(const_cast<char*>(mapped), file_size);
+  graph.build_successor_lists();
+  return graph;
+}
+
 }  // namespace motion_primitives
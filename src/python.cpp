@@ -3,8 +3,11 @@
 #include <motion_primitives/motion_primitive_graph.h>
 #include <motion_primitives/utils.h>
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 namespace py = pybind11;
 using namespace motion_primitives;
@@ -21,22 +24,77 @@ PYBIND11_MODULE(motion_primitives_cpp, m) {
       .def_readwrite("parallel_expand", &GraphSearch::Option::parallel_expand)
       .def_readwrite("heuristic", &GraphSearch::Option::heuristic)
       .def_readwrite("access_graph", &GraphSearch::Option::access_graph)
-      .def_readwrite("using_ros", &GraphSearch::Option::using_ros);
+      .def_readwrite("using_ros", &GraphSearch::Option::using_ros)
+      .def_readwrite("step_size", &GraphSearch::Option::step_size)
+      .def_readwrite("unknown_is_free", &GraphSearch::Option::unknown_is_free)
+      .def_readwrite("use_esdf", &GraphSearch::Option::use_esdf)
+      .def_readwrite("hda_star", &GraphSearch::Option::hda_star)
+      .def_readwrite("num_threads", &GraphSearch::Option::num_threads)
+      .def_readwrite("deadline", &GraphSearch::Option::deadline)
+      .def_readwrite("heuristic_inflation",
+                     &GraphSearch::Option::heuristic_inflation)
+      .def_readwrite("prune_goal_retreat",
+                     &GraphSearch::Option::prune_goal_retreat);
 
   py::class_<MotionPrimitiveGraph>(m, "MotionPrimitiveGraph").def(py::init<>());
   py::class_<::kr_planning_msgs::VoxelMap>(m, "VoxelMap")
       .def(py::init<>())
-      .def_readwrite("resolution", &::kr_planning_msgs::VoxelMap::resolution);
+      .def_readwrite("resolution", &::kr_planning_msgs::VoxelMap::resolution)
+      // dim and origin as plain 3-tuples so maps can be built from python
+      // without going through read_bag.
+      .def_property(
+          "dim",
+          [](const ::kr_planning_msgs::VoxelMap& map) {
+            return py::make_tuple(map.dim.x, map.dim.y, map.dim.z);
+          },
+          [](::kr_planning_msgs::VoxelMap& map,
+             const std::array<double, 3>& dim) {
+            map.dim.x = dim[0];
+            map.dim.y = dim[1];
+            map.dim.z = dim[2];
+          })
+      .def_property(
+          "origin",
+          [](const ::kr_planning_msgs::VoxelMap& map) {
+            return py::make_tuple(map.origin.x, map.origin.y, map.origin.z);
+          },
+          [](::kr_planning_msgs::VoxelMap& map,
+             const std::array<double, 3>& origin) {
+            map.origin.x = origin[0];
+            map.origin.y = origin[1];
+            map.origin.z = origin[2];
+          })
+      // Occupancy data as an int8 numpy array. The getter is a zero-copy
+      // view over the message's storage (kept alive by passing the map as
+      // the array's base); the setter copies in, since a std::vector cannot
+      // alias numpy-owned memory.
+      .def_property(
+          "data",
+          [](py::object& self) {
+            auto& map = self.cast<::kr_planning_msgs::VoxelMap&>();
+            return py::array_t<int8_t>(
+                {static_cast<py::ssize_t>(map.data.size())},
+                {static_cast<py::ssize_t>(sizeof(int8_t))}, map.data.data(),
+                self);
+          },
+          [](::kr_planning_msgs::VoxelMap& map,
+             const py::array_t<int8_t>& data) {
+            map.data.assign(data.data(), data.data() + data.size());
+          });
 
   py::class_<GraphSearch>(m, "GraphSearch")
       .def(py::init<const MotionPrimitiveGraph&,
                     const kr_planning_msgs::VoxelMap&,
                     const GraphSearch::Option&>())
-      .def("Search",
-           [](GraphSearch& gs) {
-             auto x = gs.Search();
-             return x.second;
-           })
+      // GIL released during the search so parallel_expand/hda_star get all
+      // cores and python-side threads can overlap searches.
+      .def(
+          "Search",
+          [](GraphSearch& gs) {
+            auto x = gs.Search();
+            return x.second;
+          },
+          py::call_guard<py::gil_scoped_release>())
       .def("num_visited", [](const GraphSearch& gs) {
         return static_cast<int>(gs.GetVisitedStates().size());
       });
@@ -49,5 +107,34 @@ PYBIND11_MODULE(motion_primitives_cpp, m) {
 
   m.def("read_motion_primitive_graph", &read_motion_primitive_graph);
 
+  // Runs one search per Option against the same graph and map across a TBB
+  // pool and returns (costs, num_visited) aligned with the input: one call,
+  // one GIL release, instead of a serialized python loop.
+  m.def(
+      "batch_search",
+      [](const MotionPrimitiveGraph& graph,
+         const kr_planning_msgs::VoxelMap& voxel_map,
+         const std::vector<GraphSearch::Option>& options) {
+        std::vector<double> costs(options.size(), -1);
+        std::vector<int> num_visited(options.size(), 0);
+        // Graphs coming from python usually lack sample tables; warm one
+        // copy here so the concurrent constructors below copy the tables
+        // instead of each rebuilding them.
+        MotionPrimitiveGraph warmed = graph;
+        if (!options.empty())
+          warmed.precompute_sample_tables(options.front().step_size);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, options.size()),
+            [&](const tbb::blocked_range<size_t>& r) {
+              for (size_t i = r.begin(); i < r.end(); ++i) {
+                GraphSearch gs(warmed, voxel_map, options[i]);
+                costs[i] = gs.Search().second;
+                num_visited[i] = static_cast<int>(gs.GetVisitedStates().size());
+              }
+            });
+        return std::make_pair(costs, num_visited);
+      },
+      py::call_guard<py::gil_scoped_release>());
+
   m.def("read_bag", &read_bag<kr_planning_msgs::VoxelMap>);
 }
@@ -0,0 +1,164 @@
+// Copyright 2021 Laura Jarin-Lipschitz
+//
+// Performance regression gate for the planner hot paths. Run from the
+// tests/ directory (the fixtures load the json graphs by relative path):
+//   ./benchmark_graph_search
+// Everything uses using_ros = false so the suite runs headless.
+#include <benchmark/benchmark.h>
+
+#include "motion_primitives/graph_search.h"
+#include "motion_primitives/motion_primitive_graph.h"
+
+namespace motion_primitives {
+
+// Backdoor into the private hot paths so they can be measured in isolation
+// (see the friend declaration in GraphSearch).
+struct GraphSearchBenchmarkAccess {
+  static std::vector<GraphSearch::Node> Expand(
+      const GraphSearch& gs, const GraphSearch::Node& node,
+      const GraphSearch::State& goal_state) {
+    return gs.Expand(node, goal_state);
+  }
+  static std::pair<bool, GraphSearch::Node> ExpandSingleNode(
+      const GraphSearch& gs, int index1, int index2,
+      const GraphSearch::Node& node, const GraphSearch::State& goal_state) {
+    return gs.ExpandSingleNode(index1, index2, node, goal_state);
+  }
+  static bool IsMpCollisionFree(const GraphSearch& gs,
+                                const std::shared_ptr<MotionPrimitive>& mp) {
+    return gs.is_mp_collision_free(mp);
+  }
+  static double ComputeHeuristic(const GraphSearch& gs,
+                                 const GraphSearch::State& state,
+                                 const GraphSearch::State& goal_state) {
+    return gs.ComputeHeuristic(state, goal_state);
+  }
+};
+
+namespace {
+
+kr_planning_msgs::VoxelMap make_map() {
+  kr_planning_msgs::VoxelMap voxel_map;
+  voxel_map.resolution = 1.;
+  voxel_map.dim.x = 20;
+  voxel_map.dim.y = 20;
+  voxel_map.data.resize(voxel_map.dim.x * voxel_map.dim.y, 0);
+  return voxel_map;
+}
+
+GraphSearch::Option make_option(bool parallel_expand) {
+  Eigen::Vector2d start(3, 3);
+  Eigen::Vector2d goal(15, 15);
+  GraphSearch::Option option{
+      .start_state = start,
+      .goal_state = goal,
+      .distance_threshold = 0.001,
+      .parallel_expand = parallel_expand,
+      .heuristic = "min_time",
+      .access_graph = false,
+      .start_index = 0,
+      .fixed_z = 0,
+  };
+  option.using_ros = false;
+  return option;
+}
+
+void BM_Search(benchmark::State& state) {
+  const auto mp_graph = read_motion_primitive_graph("simple_test.json");
+  const auto voxel_map = make_map();
+  const auto option = make_option(state.range(0) != 0);
+  for (auto _ : state) {
+    GraphSearch gs(mp_graph, voxel_map, option);
+    benchmark::DoNotOptimize(gs.Search());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Search)->Arg(0)->Arg(1)->ArgName("parallel");
+
+void BM_Expand(benchmark::State& state) {
+  const auto mp_graph = read_motion_primitive_graph("simple_test.json");
+  const auto option = make_option(false);
+  GraphSearch gs(mp_graph, make_map(), option);
+  GraphSearch::Node node;
+  node.state_index = 0;
+  node.state = option.start_state;
+  node.motion_cost = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        GraphSearchBenchmarkAccess::Expand(gs, node, option.goal_state));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Expand);
+
+void BM_ExpandSingleNode(benchmark::State& state) {
+  const auto mp_graph = read_motion_primitive_graph("simple_test.json");
+  const auto option = make_option(false);
+  GraphSearch gs(mp_graph, make_map(), option);
+  GraphSearch::Node node;
+  node.state_index = 0;
+  node.state = option.start_state;
+  node.motion_cost = 0;
+  const int end_index = mp_graph.successors_begin(0)->end_index;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GraphSearchBenchmarkAccess::ExpandSingleNode(
+        gs, end_index, 0, node, option.goal_state));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExpandSingleNode);
+
+void BM_IsMpCollisionFree(benchmark::State& state) {
+  const auto mp_graph = read_motion_primitive_graph("simple_test.json");
+  GraphSearch gs(mp_graph, make_map(), make_option(false));
+  const int end_index = mp_graph.successors_begin(0)->end_index;
+  const auto mp = mp_graph.get_mp_between_indices(end_index, 0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        GraphSearchBenchmarkAccess::IsMpCollisionFree(gs, mp));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IsMpCollisionFree);
+
+void BM_Heuristic(benchmark::State& state, const std::string& heuristic) {
+  const auto mp_graph = read_motion_primitive_graph("simple_test.json");
+  auto option = make_option(false);
+  option.heuristic = heuristic;
+  GraphSearch gs(mp_graph, make_map(), option);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GraphSearchBenchmarkAccess::ComputeHeuristic(
+        gs, option.start_state, option.goal_state));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+// The BVP heuristics that need 3rd-order states (ruckig_bvp, eth_bvp) are
+// not representable on the 2nd-order test graph; they can be benchmarked by
+// pointing the fixture at a 3rd-order graph file.
+BENCHMARK_CAPTURE(BM_Heuristic, zero, "zero");
+BENCHMARK_CAPTURE(BM_Heuristic, min_time, "min_time");
+BENCHMARK_CAPTURE(BM_Heuristic, min_time_bvp, "min_time_bvp");
+
+void BM_VectorXdHash(benchmark::State& state) {
+  Eigen::VectorXd v(4);
+  v << 1.234, -5.678, 0.1, 2.2;
+  VectorXdHash hash;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(hash(v));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VectorXdHash);
+
+void BM_ReadGraph(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(read_motion_primitive_graph("simple_test.json"));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadGraph);
+
+}  // namespace
+}  // namespace motion_primitives
+
+BENCHMARK_MAIN();
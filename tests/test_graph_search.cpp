@@ -5,7 +5,26 @@
 #include <ros/console.h>
 
 #include "motion_primitives/graph_search.h"
+
+namespace motion_primitives {
+// Backdoor into the private heuristic paths (see the friend declaration in
+// GraphSearch); the benchmark binary carries its own copy of this struct.
+struct GraphSearchBenchmarkAccess {
+  static Eigen::VectorXd ComputeHeuristicBatch(
+      const GraphSearch& gs, const Eigen::MatrixXd& states,
+      const GraphSearch::State& goal_state) {
+    return gs.ComputeHeuristicBatch(states, goal_state);
+  }
+  static double ComputeHeuristic(const GraphSearch& gs,
+                                 const GraphSearch::State& state,
+                                 const GraphSearch::State& goal_state) {
+    return gs.ComputeHeuristic(state, goal_state);
+  }
+};
+}  // namespace motion_primitives
+
 using motion_primitives::GraphSearch;
+using motion_primitives::GraphSearchBenchmarkAccess;
 using motion_primitives::read_motion_primitive_graph;
 namespace {
 class GraphSearchTest : public ::testing::Test {
@@ -70,6 +89,58 @@ TEST_F(GraphSearchTest, ShiftPolynomial) {
   EXPECT_EQ(unshifted_state, shifted_state);
 }
 
+TEST_F(GraphSearchTest, BatchHeuristicMatchesScalarTest) {
+  // The vectorized batch path must agree column-for-column with the scalar
+  // per-successor evaluation it replaces. complex_test.json has a nonzero
+  // rho, so the min_time values are nontrivial.
+  const auto mp_graph = read_motion_primitive_graph("complex_test.json");
+  for (const std::string heuristic : {"min_time", "zero"}) {
+    auto option = option_;
+    option.heuristic = heuristic;
+    GraphSearch gs(mp_graph, voxel_map_, option);
+
+    Eigen::MatrixXd states = Eigen::MatrixXd::Zero(mp_graph.state_dim(), 4);
+    states.row(0) << 1.5, 3.0, -2.0, 7.25;
+    states.row(1) << 2.0, -1.0, 4.0, 0.5;
+    GraphSearch::State goal = GraphSearch::State::Zero(mp_graph.state_dim());
+    goal.head(2) << 5, 5;
+
+    const Eigen::VectorXd batch =
+        GraphSearchBenchmarkAccess::ComputeHeuristicBatch(gs, states, goal);
+    ASSERT_EQ(batch.size(), states.cols());
+    for (int i = 0; i < states.cols(); ++i) {
+      const GraphSearch::State state = states.col(i);
+      EXPECT_DOUBLE_EQ(
+          batch(i), GraphSearchBenchmarkAccess::ComputeHeuristic(gs, state,
+                                                                 goal));
+    }
+  }
+}
+
+TEST_F(GraphSearchTest, CollisionCacheInvalidationTest) {
+  GraphSearch::SearchContext context;
+  GraphSearch::SearchContext::CollisionKey key1{0, Eigen::Vector3i(1, 1, 0)};
+  GraphSearch::SearchContext::CollisionKey key2{1, Eigen::Vector3i(8, 8, 0)};
+  GraphSearch::SearchContext::CollisionVerdict verdict;
+  verdict.free = true;
+  verdict.aabb_min = Eigen::Vector3f(0, 0, 0);
+  verdict.aabb_max = Eigen::Vector3f(2, 2, 1);
+  context.collision_cache.emplace(key1, verdict);
+  verdict.aabb_min = Eigen::Vector3f(7, 7, 0);
+  verdict.aabb_max = Eigen::Vector3f(9, 9, 1);
+  context.collision_cache.emplace(key2, verdict);
+
+  // A dirty box overlapping only the first entry's AABB drops only it.
+  context.MarkDirty({{Eigen::Vector3f(1, 1, 0), Eigen::Vector3f(3, 3, 1)}});
+  context.ApplyPendingInvalidations();
+  EXPECT_EQ(context.collision_cache.count(key1), 0u);
+  EXPECT_EQ(context.collision_cache.count(key2), 1u);
+
+  context.DropCollisionCache();
+  context.ApplyPendingInvalidations();
+  EXPECT_EQ(context.collision_cache.count(key2), 0u);
+}
+
 TEST_F(GraphSearchTest, getStateTest) {
   const auto mp_graph = read_motion_primitive_graph("simple_test.json");
   GraphSearch gs(mp_graph, voxel_map_, option_);
@@ -13,4 +13,47 @@ TEST(GraphTest, MotionPrimitiveFactoryTest) {
   auto mp = mp_graph.createMotionPrimitivePtrFromGraph(start_state, end_state);
   EXPECT_GE(mp->cost_, 0);
 }
+
+TEST(GraphTest, BinaryRoundTripTest) {
+  const auto mp_graph = read_motion_primitive_graph("simple_test.json");
+  motion_primitives::write_motion_primitive_graph_binary(
+      mp_graph, "simple_test_round_trip.mpb");
+  const auto mp_graph2 =
+      read_motion_primitive_graph("simple_test_round_trip.mpb");
+  EXPECT_EQ(mp_graph.spatial_dim(), mp_graph2.spatial_dim());
+  EXPECT_EQ(mp_graph.state_dim(), mp_graph2.state_dim());
+  EXPECT_EQ(mp_graph.num_tiled_states(), mp_graph2.num_tiled_states());
+  EXPECT_EQ(mp_graph.vertices(), mp_graph2.vertices());
+  EXPECT_TRUE((mp_graph.edges() == mp_graph2.edges()).all());
+  for (int i = 0; i < mp_graph.num_tiled_states(); i++) {
+    for (int j = 0; j < mp_graph.vertices().rows(); j++) {
+      if (!mp_graph.HasEdge(i, j)) continue;
+      const auto mp = mp_graph.get_mp_between_indices(i, j);
+      const auto mp2 = mp_graph2.get_mp_between_indices(i, j);
+      EXPECT_EQ(mp->cost_, mp2->cost_);
+      EXPECT_EQ(mp->traj_time_, mp2->traj_time_);
+      EXPECT_EQ(mp->start_state_, mp2->start_state_);
+      EXPECT_EQ(mp->end_state_, mp2->end_state_);
+      EXPECT_EQ(mp->poly_coeffs_, mp2->poly_coeffs_);
+    }
+  }
+}
+
+TEST(GraphTest, EvaluatePositionsBatchTest) {
+  const auto mp_graph = read_motion_primitive_graph("simple_test.json");
+  for (int i = 0; i < mp_graph.num_tiled_states(); i++) {
+    for (int j = 0; j < mp_graph.vertices().rows(); j++) {
+      if (!mp_graph.HasEdge(i, j)) continue;
+      const auto mp = mp_graph.get_mp_between_indices(i, j);
+      const Eigen::VectorXd times =
+          Eigen::VectorXd::LinSpaced(11, 0, mp->traj_time_);
+      // The batched evaluation must agree with the per-time scalar one.
+      const Eigen::MatrixXd batch = mp->evaluate_positions(times);
+      for (int k = 0; k < times.size(); k++) {
+        EXPECT_LT(
+            (batch.col(k) - mp->evaluate_primitive(times(k))).norm(), 1e-9);
+      }
+    }
+  }
+}
 }  // namespace
\ No newline at end of file